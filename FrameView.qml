@@ -0,0 +1,7 @@
+import QtQuick 2.15
+import VisionNative 1.0
+
+// Native display, loaded by ui.qml only when the frame_item library is available
+FrameItem {
+    name: "inference"
+}
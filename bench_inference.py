@@ -0,0 +1,55 @@
+"""Times Yolo11n's per-frame Python steps: letterbox, tensor conversion and NMS
+
+These are the methods inference_worker runs on every detection, timed on
+their own so x86 and Pi runs can be compared step by step:
+
+    python bench_inference.py
+    python bench_inference.py --sizes 640x480,1920x1080 --candidates 32,256,1024
+"""
+import argparse
+import platform
+import timeit
+import cv2
+import numpy as np
+from inference_worker import Yolo11n
+
+
+def best_ms(fn, number):
+    """Best of 5 repeats, per call"""
+    return min(timeit.repeat(fn, number=number, repeat=5)) / number * 1000
+
+
+def random_boxes(rng, count):
+    """xyxy boxes and scores shaped like the candidates left after the confidence threshold"""
+    xy = rng.uniform(0, 600, (count, 2)).astype(np.float32)
+    wh = rng.uniform(10, 120, (count, 2)).astype(np.float32)
+    return np.hstack([xy, xy + wh]), rng.uniform(0, 1, count).astype(np.float32)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sizes", default="640x480,1280x1024,1920x1080", help="frame sizes WxH")
+    parser.add_argument("--candidates", default="32,256,1024", help="boxes going into NMS")
+    parser.add_argument("--number", type=int, default=50, help="calls per repeat")
+    args = parser.parse_args()
+
+    # letterbox, to_tensor and nms don't touch the model, skip loading it
+    yolo = Yolo11n.__new__(Yolo11n)
+    rng = np.random.default_rng(42)
+    print(f"machine {platform.machine()}, numpy {np.__version__}, opencv {cv2.__version__}")
+
+    for size in args.sizes.split(","):
+        width, height = (int(v) for v in size.split("x"))
+        frame = rng.integers(0, 256, (height, width, 3), dtype=np.uint8)
+        print(f"letterbox {size}: {best_ms(lambda: yolo.letterbox(frame), args.number):.3f} ms")
+
+    img, _, _ = yolo.letterbox(frame)
+    print(f"to_tensor 640x640: {best_ms(lambda: yolo.to_tensor(img), args.number):.3f} ms")
+
+    for count in (int(v) for v in args.candidates.split(",")):
+        boxes, scores = random_boxes(rng, count)
+        print(f"nms {count} boxes: {best_ms(lambda: yolo.nms(boxes, scores, 0.7), args.number):.3f} ms")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,345 @@
+#include "batch_udp_sink.h"
+#include "udp_batch.h"
+#include <string>
+
+#ifdef __linux__
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+using namespace std;
+
+// A frame without a marker in sight (non-RTP input) is sent once this many
+// datagrams are waiting
+static const size_t MAX_BATCH = 1024;
+
+struct BatchUdpSink {
+    GstBaseSink parent;
+
+    // Properties, guarded by the object lock
+    gchar *host;
+    gint port;
+    gboolean gso;
+    guint max_rate;       // kbit/s
+    gint burst;
+    gboolean changed;     // picked up by the streaming thread before the next packet
+    guint64 packets;
+    guint64 syscalls;
+
+    UdpBatchSender *sender;   // streaming thread only
+};
+
+struct BatchUdpSinkClass {
+    GstBaseSinkClass parent_class;
+};
+
+enum {
+    PROP_0,
+    PROP_HOST,
+    PROP_PORT,
+    PROP_GSO,
+    PROP_MAX_RATE,
+    PROP_BURST,
+    PROP_PACKETS,
+    PROP_SYSCALLS
+};
+
+GST_DEBUG_CATEGORY_STATIC(batch_udp_sink_debug);
+#define GST_CAT_DEFAULT batch_udp_sink_debug
+
+static GstStaticPadTemplate sink_template =
+    GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+G_DEFINE_TYPE(BatchUdpSink, batch_udp_sink, GST_TYPE_BASE_SINK)
+
+static BatchUdpSink *as_sink(gpointer object)
+{
+    return reinterpret_cast<BatchUdpSink *>(object);
+}
+
+// ===================== Streaming thread =====================
+
+// Hands property changes to the sender. On start a bad destination is an
+// error; while playing it is a warning and the old destination stays.
+static bool apply_settings(BatchUdpSink *sink, bool starting)
+{
+    GST_OBJECT_LOCK(sink);
+    if (!sink->changed) {
+        GST_OBJECT_UNLOCK(sink);
+        return true;
+    }
+    const string host = sink->host ? sink->host : "";
+    const int port = sink->port;
+    const bool gso = sink->gso;
+    const guint max_rate = sink->max_rate;
+    const int burst = sink->burst;
+    sink->changed = FALSE;
+    GST_OBJECT_UNLOCK(sink);
+
+    sink->sender->set_gso(gso);
+    sink->sender->set_max_rate(static_cast<uint64_t>(max_rate) * 1000, burst);
+    string error;
+    if (!sink->sender->open(host, port, &error)) {
+        if (starting) {
+            GST_ELEMENT_ERROR(sink, RESOURCE, OPEN_WRITE,
+                              ("Could not send to %s:%d", host.c_str(), port), ("%s", error.c_str()));
+        } else {
+            GST_ELEMENT_WARNING(sink, RESOURCE, SETTINGS,
+                                ("Could not send to %s:%d", host.c_str(), port), ("%s", error.c_str()));
+        }
+        return false;
+    }
+    GST_INFO_OBJECT(sink, "sending to %s:%d, GSO %s, max rate %u kbit/s", host.c_str(), port,
+                    sink->sender->gso_active() ? "on" : "off", max_rate);
+    return true;
+}
+
+// True when buffer completes a frame: an RTP packet with the marker bit, or
+// anything that isn't RTP
+static bool add_buffer(BatchUdpSink *sink, GstBuffer *buffer)
+{
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ))
+        return false;
+    sink->sender->add(map.data, map.size);
+    const bool rtp = map.size >= 12 && (map.data[0] >> 6) == 2;
+    const bool marker = rtp && (map.data[1] & 0x80);
+    gst_buffer_unmap(buffer, &map);
+    return !rtp || marker;
+}
+
+static GstFlowReturn flush_batch(BatchUdpSink *sink)
+{
+    if (sink->sender->pending() == 0)
+        return GST_FLOW_OK;
+    if (!sink->sender->flush()) {
+        // Like udpsink, a failed send is reported and streaming carries on
+        GST_ELEMENT_WARNING(sink, RESOURCE, WRITE, ("Error sending UDP packets"),
+                            ("%s", sink->sender->error_text().c_str()));
+    }
+    const UdpBatchStats &stats = sink->sender->stats();
+    GST_OBJECT_LOCK(sink);
+    sink->packets = stats.packets;
+    sink->syscalls = stats.syscalls;
+    GST_OBJECT_UNLOCK(sink);
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn batch_udp_sink_render(GstBaseSink *base, GstBuffer *buffer)
+{
+    BatchUdpSink *sink = as_sink(base);
+    apply_settings(sink, false);
+    const bool frame_end = add_buffer(sink, buffer);
+    if (frame_end || sink->sender->pending() >= MAX_BATCH)
+        return flush_batch(sink);
+    return GST_FLOW_OK;
+}
+
+// rtph264pay pushes a list per NAL unit and a frame can be several slices,
+// so lists are collected like single buffers until the marker ends the frame
+static GstFlowReturn batch_udp_sink_render_list(GstBaseSink *base, GstBufferList *list)
+{
+    BatchUdpSink *sink = as_sink(base);
+    apply_settings(sink, false);
+    const guint length = gst_buffer_list_length(list);
+    GstFlowReturn ret = GST_FLOW_OK;
+    for (guint i = 0; i < length; ++i) {
+        const bool frame_end = add_buffer(sink, gst_buffer_list_get(list, i));
+        if (frame_end || sink->sender->pending() >= MAX_BATCH)
+            ret = flush_batch(sink);
+    }
+    return ret;
+}
+
+// FLUSH_STOP arrives on the streaming thread once upstream has stopped, so
+// the half collected frame from before the flush can be dropped there
+static gboolean batch_udp_sink_event(GstBaseSink *base, GstEvent *event)
+{
+    BatchUdpSink *sink = as_sink(base);
+    switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_EOS:
+        flush_batch(sink);
+        break;
+    case GST_EVENT_FLUSH_STOP:
+        sink->sender->clear();
+        break;
+    default:
+        break;
+    }
+    return GST_BASE_SINK_CLASS(batch_udp_sink_parent_class)->event(base, event);
+}
+
+// Called from another thread on FLUSH_START and on the way to READY: a paced
+// send in render() gives up instead of sleeping out the rest of its frame
+static gboolean batch_udp_sink_unlock(GstBaseSink *base)
+{
+    as_sink(base)->sender->interrupt(true);
+    return TRUE;
+}
+
+static gboolean batch_udp_sink_unlock_stop(GstBaseSink *base)
+{
+    as_sink(base)->sender->interrupt(false);
+    return TRUE;
+}
+
+static gboolean batch_udp_sink_start(GstBaseSink *base)
+{
+    BatchUdpSink *sink = as_sink(base);
+    GST_OBJECT_LOCK(sink);
+    sink->changed = TRUE;
+    GST_OBJECT_UNLOCK(sink);
+    return apply_settings(sink, true);
+}
+
+static gboolean batch_udp_sink_stop(GstBaseSink *base)
+{
+    // Streaming has stopped; a frame still being collected is incomplete
+    BatchUdpSink *sink = as_sink(base);
+    sink->sender->clear();
+    sink->sender->close();
+    return TRUE;
+}
+
+// ===================== GObject =====================
+
+static void batch_udp_sink_set_property(GObject *object, guint id, const GValue *value, GParamSpec *pspec)
+{
+    BatchUdpSink *sink = as_sink(object);
+    GST_OBJECT_LOCK(sink);
+    switch (id) {
+    case PROP_HOST:
+        g_free(sink->host);
+        sink->host = g_value_dup_string(value);
+        break;
+    case PROP_PORT:
+        sink->port = g_value_get_int(value);
+        break;
+    case PROP_GSO:
+        sink->gso = g_value_get_boolean(value);
+        break;
+    case PROP_MAX_RATE:
+        sink->max_rate = g_value_get_uint(value);
+        break;
+    case PROP_BURST:
+        sink->burst = g_value_get_int(value);
+        break;
+    default:
+        GST_OBJECT_UNLOCK(sink);
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+        return;
+    }
+    sink->changed = TRUE;
+    GST_OBJECT_UNLOCK(sink);
+}
+
+static void batch_udp_sink_get_property(GObject *object, guint id, GValue *value, GParamSpec *pspec)
+{
+    BatchUdpSink *sink = as_sink(object);
+    GST_OBJECT_LOCK(sink);
+    switch (id) {
+    case PROP_HOST:
+        g_value_set_string(value, sink->host);
+        break;
+    case PROP_PORT:
+        g_value_set_int(value, sink->port);
+        break;
+    case PROP_GSO:
+        g_value_set_boolean(value, sink->gso);
+        break;
+    case PROP_MAX_RATE:
+        g_value_set_uint(value, sink->max_rate);
+        break;
+    case PROP_BURST:
+        g_value_set_int(value, sink->burst);
+        break;
+    case PROP_PACKETS:
+        g_value_set_uint64(value, sink->packets);
+        break;
+    case PROP_SYSCALLS:
+        g_value_set_uint64(value, sink->syscalls);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(sink);
+}
+
+static void batch_udp_sink_finalize(GObject *object)
+{
+    BatchUdpSink *sink = as_sink(object);
+    delete sink->sender;
+    g_free(sink->host);
+    G_OBJECT_CLASS(batch_udp_sink_parent_class)->finalize(object);
+}
+
+static void batch_udp_sink_class_init(BatchUdpSinkClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseSinkClass *basesink_class = GST_BASE_SINK_CLASS(klass);
+    const GParamFlags writable = static_cast<GParamFlags>(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+    const GParamFlags readonly = static_cast<GParamFlags>(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    gobject_class->set_property = batch_udp_sink_set_property;
+    gobject_class->get_property = batch_udp_sink_get_property;
+    gobject_class->finalize = batch_udp_sink_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_HOST,
+        g_param_spec_string("host", "Host", "Receiver address", "127.0.0.1", writable));
+    g_object_class_install_property(gobject_class, PROP_PORT,
+        g_param_spec_int("port", "Port", "Receiver UDP port", 1, 65535, 5000, writable));
+    g_object_class_install_property(gobject_class, PROP_GSO,
+        g_param_spec_boolean("gso", "GSO", "Use UDP segmentation offload when the kernel has it",
+                             TRUE, writable));
+    g_object_class_install_property(gobject_class, PROP_MAX_RATE,
+        g_param_spec_uint("max-rate", "Max rate", "Pacing rate in kbit/s, 0 sends each frame at once",
+                          0, G_MAXUINT, 0, writable));
+    g_object_class_install_property(gobject_class, PROP_BURST,
+        g_param_spec_int("burst", "Burst", "Datagrams per send when pacing", 1, 1024, 32, writable));
+    g_object_class_install_property(gobject_class, PROP_PACKETS,
+        g_param_spec_uint64("packets", "Packets", "Datagrams sent", 0, G_MAXUINT64, 0, readonly));
+    g_object_class_install_property(gobject_class, PROP_SYSCALLS,
+        g_param_spec_uint64("syscalls", "Syscalls", "sendmmsg calls made", 0, G_MAXUINT64, 0, readonly));
+
+    gst_element_class_set_static_metadata(element_class, "Batched UDP sink", "Sink/Network",
+        "Sends RTP packets a frame at a time with sendmmsg and UDP GSO", "camera_module");
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+
+    basesink_class->start = batch_udp_sink_start;
+    basesink_class->stop = batch_udp_sink_stop;
+    basesink_class->unlock = batch_udp_sink_unlock;
+    basesink_class->unlock_stop = batch_udp_sink_unlock_stop;
+    basesink_class->render = batch_udp_sink_render;
+    basesink_class->render_list = batch_udp_sink_render_list;
+    basesink_class->event = batch_udp_sink_event;
+
+    GST_DEBUG_CATEGORY_INIT(batch_udp_sink_debug, "batchudpsink", 0, "Batched UDP sink");
+}
+
+static void batch_udp_sink_init(BatchUdpSink *sink)
+{
+    sink->host = g_strdup("127.0.0.1");
+    sink->port = 5000;
+    sink->gso = TRUE;
+    sink->max_rate = 0;
+    sink->burst = 32;
+    sink->changed = TRUE;
+    sink->packets = 0;
+    sink->syscalls = 0;
+    sink->sender = new UdpBatchSender();
+}
+
+bool batch_udp_sink_register()
+{
+    return gst_element_register(nullptr, "batchudpsink", GST_RANK_NONE, batch_udp_sink_get_type());
+}
+
+#else
+
+bool batch_udp_sink_register()
+{
+    return false;
+}
+
+#endif
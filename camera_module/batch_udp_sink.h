@@ -0,0 +1,18 @@
+// batch_udp_sink.h : "batchudpsink", a udpsink replacement sending per frame
+//
+// udpsink makes one sendto per RTP packet. This sink collects the packets of
+// a frame, single buffers and buffer lists alike, up to the RTP marker bit and
+// sends them with UdpBatchSender: one sendmmsg, UDP GSO when
+// available, optional pacing. host and port can be changed while playing,
+// like udpsink's.
+//
+//   ... ! rtph264pay ! batchudpsink host=192.168.1.42 port=5000 max-rate=50000
+//
+// Properties: host, port, gso (default true), max-rate (kbit/s, 0 = no
+// pacing), burst (datagrams per paced send), and read-only packets/syscalls.
+
+#pragma once
+
+// Registers the element with the application's static registry, call after
+// gst_init(). False where the sink isn't supported (non-Linux).
+bool batch_udp_sink_register();
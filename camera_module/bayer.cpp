@@ -0,0 +1,441 @@
+#include "bayer.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BAYER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BAYER_AVX2_TARGET
+#else
+#define BAYER_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BAYER_NEON 1
+#include <arm_neon.h>
+#endif
+
+// All paths share these roundings so SIMD and scalar output match bit for bit:
+//   avg2 = (a + b + 1) >> 1, avg4 = (a + b + c + d + 2) >> 2
+//   Y = ((66 R + 129 G + 25 B + 128) >> 8) + 16
+//   U = ((-38 R - 74 G + 112 B + 128) >> 8) + 128   (arithmetic shift)
+//   V = ((112 R - 94 G - 18 B + 128) >> 8) + 128
+// Chroma is computed from the rounded average RGB of each 2x2 block.
+
+enum { RED, GREEN, BLUE };
+
+static const int PATTERN_COLOURS[4][2][2] = {
+    {{RED, GREEN}, {GREEN, BLUE}},   // RGGB
+    {{BLUE, GREEN}, {GREEN, RED}},   // BGGR
+    {{GREEN, RED}, {BLUE, GREEN}},   // GRBG
+    {{GREEN, BLUE}, {RED, GREEN}},   // GBRG
+};
+
+static inline int luma(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline int chroma_u(int r, int g, int b)
+{
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline int chroma_v(int r, int g, int b)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+// Reflect-101 so border pixels see neighbours of the right colour.
+static inline int reflect(int i, int n)
+{
+    if (i < 0) return -i;
+    if (i >= n) return 2 * n - 2 - i;
+    return i;
+}
+
+unsigned int i420_size(int width, int height)
+{
+    return static_cast<unsigned int>(width * height + 2 * (width / 2) * (height / 2));
+}
+
+// ===================== Scalar =====================
+
+struct Rgb {
+    int r, g, b;
+};
+
+static inline Rgb demosaic_pixel(const unsigned char *raw, int width, int height, int stride,
+                                 const int (*colours)[2], int y, int x)
+{
+    const unsigned char *up = raw + reflect(y - 1, height) * stride;
+    const unsigned char *row = raw + y * stride;
+    const unsigned char *down = raw + reflect(y + 1, height) * stride;
+    const int left = reflect(x - 1, width), right = reflect(x + 1, width);
+
+    const int centre = row[x];
+    const int cross = (row[left] + row[right] + up[x] + down[x] + 2) >> 2;
+    const int diagonal = (up[left] + up[right] + down[left] + down[right] + 2) >> 2;
+    const int horizontal = (row[left] + row[right] + 1) >> 1;
+    const int vertical = (up[x] + down[x] + 1) >> 1;
+
+    Rgb p;
+    switch (colours[y & 1][x & 1]) {
+    case RED:
+        p.r = centre; p.g = cross; p.b = diagonal;
+        break;
+    case BLUE:
+        p.r = diagonal; p.g = cross; p.b = centre;
+        break;
+    default:
+        p.g = centre;
+        if (colours[y & 1][(x & 1) ^ 1] == RED) {
+            p.r = horizontal; p.b = vertical;
+        } else {
+            p.r = vertical; p.b = horizontal;
+        }
+        break;
+    }
+    return p;
+}
+
+// Converts 2x2 output blocks with top-left column x in [x_begin, x_end) of the
+// row pair starting at y.
+static void demosaic_block_range_scalar(const unsigned char *raw, int width, int height, int stride,
+                                        BayerPattern pattern, int y, int x_begin, int x_end,
+                                        unsigned char *y_plane, unsigned char *u_plane, unsigned char *v_plane)
+{
+    const int (*colours)[2] = PATTERN_COLOURS[pattern];
+    unsigned char *y0 = y_plane + y * width;
+    unsigned char *y1 = y0 + width;
+    unsigned char *u = u_plane + (y / 2) * (width / 2);
+    unsigned char *v = v_plane + (y / 2) * (width / 2);
+    for (int x = x_begin; x < x_end; x += 2) {
+        Rgb tl = demosaic_pixel(raw, width, height, stride, colours, y, x);
+        Rgb tr = demosaic_pixel(raw, width, height, stride, colours, y, x + 1);
+        Rgb bl = demosaic_pixel(raw, width, height, stride, colours, y + 1, x);
+        Rgb br = demosaic_pixel(raw, width, height, stride, colours, y + 1, x + 1);
+        y0[x] = static_cast<unsigned char>(luma(tl.r, tl.g, tl.b));
+        y0[x + 1] = static_cast<unsigned char>(luma(tr.r, tr.g, tr.b));
+        y1[x] = static_cast<unsigned char>(luma(bl.r, bl.g, bl.b));
+        y1[x + 1] = static_cast<unsigned char>(luma(br.r, br.g, br.b));
+        int r = (tl.r + tr.r + bl.r + br.r + 2) >> 2;
+        int g = (tl.g + tr.g + bl.g + br.g + 2) >> 2;
+        int b = (tl.b + tr.b + bl.b + br.b + 2) >> 2;
+        u[x / 2] = static_cast<unsigned char>(chroma_u(r, g, b));
+        v[x / 2] = static_cast<unsigned char>(chroma_v(r, g, b));
+    }
+}
+
+void bayer_to_i420_scalar(const unsigned char *raw, int width, int height, int stride,
+                          BayerPattern pattern, unsigned char *i420)
+{
+    unsigned char *y_plane = i420;
+    unsigned char *u_plane = y_plane + width * height;
+    unsigned char *v_plane = u_plane + (width / 2) * (height / 2);
+    for (int y = 0; y < height; y += 2)
+        demosaic_block_range_scalar(raw, width, height, stride, pattern, y, 0, width, y_plane, u_plane, v_plane);
+}
+
+void bayer_to_i420_half(const unsigned char *raw, int width, int height, int stride,
+                        BayerPattern pattern, unsigned char *i420)
+{
+    const int out_w = width / 2, out_h = height / 2;
+    unsigned char *y_plane = i420;
+    unsigned char *u_plane = y_plane + out_w * out_h;
+    unsigned char *v_plane = u_plane + (out_w / 2) * (out_h / 2);
+
+    // Offsets of each colour inside a quad: red, blue and the two greens.
+    const int (*colours)[2] = PATTERN_COLOURS[pattern];
+    int red = 0, blue = 0, green0 = -1, green1 = 0;
+    for (int i = 0; i < 4; ++i) {
+        int offset = (i >> 1) * stride + (i & 1);
+        switch (colours[i >> 1][i & 1]) {
+        case RED: red = offset; break;
+        case BLUE: blue = offset; break;
+        default: if (green0 < 0) green0 = offset; else green1 = offset; break;
+        }
+    }
+
+    // Two output rows at a time so chroma comes from the same pass.
+    for (int oy = 0; oy < out_h; oy += 2) {
+        const unsigned char *q0 = raw + (2 * oy) * stride;
+        const unsigned char *q1 = q0 + 2 * stride;
+        unsigned char *y0 = y_plane + oy * out_w;
+        unsigned char *y1 = y0 + out_w;
+        unsigned char *u = u_plane + (oy / 2) * (out_w / 2);
+        unsigned char *v = v_plane + (oy / 2) * (out_w / 2);
+        for (int ox = 0; ox < out_w; ox += 2) {
+            const unsigned char *a = q0 + 2 * ox, *b = a + 2, *c = q1 + 2 * ox, *d = c + 2;
+            int ra = a[red], ga = (a[green0] + a[green1] + 1) >> 1, ba = a[blue];
+            int rb = b[red], gb = (b[green0] + b[green1] + 1) >> 1, bb = b[blue];
+            int rc = c[red], gc = (c[green0] + c[green1] + 1) >> 1, bc = c[blue];
+            int rd = d[red], gd = (d[green0] + d[green1] + 1) >> 1, bd = d[blue];
+            y0[ox] = static_cast<unsigned char>(luma(ra, ga, ba));
+            y0[ox + 1] = static_cast<unsigned char>(luma(rb, gb, bb));
+            y1[ox] = static_cast<unsigned char>(luma(rc, gc, bc));
+            y1[ox + 1] = static_cast<unsigned char>(luma(rd, gd, bd));
+            int r = (ra + rb + rc + rd + 2) >> 2;
+            int g = (ga + gb + gc + gd + 2) >> 2;
+            int bl = (ba + bb + bc + bd + 2) >> 2;
+            u[ox / 2] = static_cast<unsigned char>(chroma_u(r, g, bl));
+            v[ox / 2] = static_cast<unsigned char>(chroma_v(r, g, bl));
+        }
+    }
+}
+
+// ===================== SIMD =====================
+//
+// Both kernels work on one row pair of an RGGB-shaped mosaic (BGGR swaps the
+// red and blue results). Even and odd columns are split into 16-bit lanes, so
+// lane k holds quad k: E = column 2k, O = column 2k + 1. Loads shifted by two
+// bytes give quads k - 1 and k + 1 for the horizontal neighbours.
+//
+//   a = row y - 1 (G B)   t = row y (R G)   b = row y + 1 (G B)   c = row y + 2 (R G)
+
+#if defined(BAYER_X86)
+
+struct Split256 {
+    __m256i e, o;
+};
+
+BAYER_AVX2_TARGET static inline Split256 load_split(const unsigned char *p)
+{
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    Split256 s;
+    s.e = _mm256_and_si256(v, _mm256_set1_epi16(0x00ff));
+    s.o = _mm256_srli_epi16(v, 8);
+    return s;
+}
+
+BAYER_AVX2_TARGET static inline __m256i avg4(__m256i a, __m256i b, __m256i c, __m256i d)
+{
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(a, b), _mm256_add_epi16(c, d));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+BAYER_AVX2_TARGET static inline __m256i luma_avx2(__m256i r, __m256i g, __m256i b)
+{
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)),
+                                   _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(25)));
+    sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+    return _mm256_add_epi16(_mm256_srli_epi16(sum, 8), _mm256_set1_epi16(16));
+}
+
+BAYER_AVX2_TARGET static inline __m256i chroma_avx2(__m256i r, __m256i g, __m256i b,
+                                                    short cr, short cg, short cb)
+{
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(cr)),
+                                   _mm256_mullo_epi16(g, _mm256_set1_epi16(cg)));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(cb)));
+    sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+    return _mm256_add_epi16(_mm256_srai_epi16(sum, 8), _mm256_set1_epi16(128));
+}
+
+// Processes columns [2, x_end) in steps of 32 and returns x_end.
+BAYER_AVX2_TARGET static int demosaic_rows_avx2(const unsigned char *ra, const unsigned char *rt,
+                                                const unsigned char *rb, const unsigned char *rc,
+                                                int width, bool swap_rb,
+                                                unsigned char *y0, unsigned char *y1,
+                                                unsigned char *u, unsigned char *v)
+{
+    int x = 2;
+    for (; x + 34 <= width; x += 32) {
+        Split256 a_l = load_split(ra + x - 2), a = load_split(ra + x);
+        Split256 t_l = load_split(rt + x - 2), t = load_split(rt + x), t_r = load_split(rt + x + 2);
+        Split256 b_l = load_split(rb + x - 2), b = load_split(rb + x), b_r = load_split(rb + x + 2);
+        Split256 c = load_split(rc + x), c_r = load_split(rc + x + 2);
+
+        // Top left: red site
+        __m256i r_tl = t.e;
+        __m256i g_tl = avg4(t_l.o, t.o, a.e, b.e);
+        __m256i b_tl = avg4(a_l.o, a.o, b_l.o, b.o);
+        // Top right: green site on a red row
+        __m256i r_tr = _mm256_avg_epu16(t.e, t_r.e);
+        __m256i g_tr = t.o;
+        __m256i b_tr = _mm256_avg_epu16(a.o, b.o);
+        // Bottom left: green site on a blue row
+        __m256i r_bl = _mm256_avg_epu16(t.e, c.e);
+        __m256i g_bl = b.e;
+        __m256i b_bl = _mm256_avg_epu16(b_l.o, b.o);
+        // Bottom right: blue site
+        __m256i r_br = avg4(t.e, t_r.e, c.e, c_r.e);
+        __m256i g_br = avg4(b.e, b_r.e, t.o, c.o);
+        __m256i b_br = b.o;
+
+        if (swap_rb) {
+            __m256i tmp;
+            tmp = r_tl; r_tl = b_tl; b_tl = tmp;
+            tmp = r_tr; r_tr = b_tr; b_tr = tmp;
+            tmp = r_bl; r_bl = b_bl; b_bl = tmp;
+            tmp = r_br; r_br = b_br; b_br = tmp;
+        }
+
+        // Even/odd luma recombined into pixel order: low byte = column 2k.
+        __m256i top = _mm256_or_si256(luma_avx2(r_tl, g_tl, b_tl), _mm256_slli_epi16(luma_avx2(r_tr, g_tr, b_tr), 8));
+        __m256i bottom = _mm256_or_si256(luma_avx2(r_bl, g_bl, b_bl), _mm256_slli_epi16(luma_avx2(r_br, g_br, b_br), 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(y0 + x), top);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(y1 + x), bottom);
+
+        __m256i r = avg4(r_tl, r_tr, r_bl, r_br);
+        __m256i g = avg4(g_tl, g_tr, g_bl, g_br);
+        __m256i bl = avg4(b_tl, b_tr, b_bl, b_br);
+        __m256i uv = _mm256_packus_epi16(chroma_avx2(r, g, bl, -38, -74, 112), chroma_avx2(r, g, bl, 112, -94, -18));
+        uv = _mm256_permute4x64_epi64(uv, 0xD8);   // [u0-7 v0-7 | u8-15 v8-15] -> [u0-15 | v0-15]
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(u + x / 2), _mm256_castsi256_si128(uv));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v + x / 2), _mm256_extracti128_si256(uv, 1));
+    }
+    return x;
+}
+
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool have_simd = cpu_has_avx2();
+
+#define demosaic_rows_simd demosaic_rows_avx2
+
+#elif defined(BAYER_NEON)
+
+struct Split128 {
+    uint16x8_t e, o;
+};
+
+static inline Split128 load_split(const unsigned char *p)
+{
+    uint8x8x2_t v = vld2_u8(p);
+    Split128 s;
+    s.e = vmovl_u8(v.val[0]);
+    s.o = vmovl_u8(v.val[1]);
+    return s;
+}
+
+static inline uint16x8_t avg4(uint16x8_t a, uint16x8_t b, uint16x8_t c, uint16x8_t d)
+{
+    uint16x8_t sum = vaddq_u16(vaddq_u16(a, b), vaddq_u16(c, d));
+    return vshrq_n_u16(vaddq_u16(sum, vdupq_n_u16(2)), 2);
+}
+
+static inline uint8x8_t luma_neon(uint16x8_t r, uint16x8_t g, uint16x8_t b)
+{
+    uint16x8_t sum = vmulq_n_u16(r, 66);
+    sum = vmlaq_n_u16(sum, g, 129);
+    sum = vmlaq_n_u16(sum, b, 25);
+    sum = vaddq_u16(sum, vdupq_n_u16(128));
+    return vmovn_u16(vaddq_u16(vshrq_n_u16(sum, 8), vdupq_n_u16(16)));
+}
+
+static inline uint8x8_t chroma_neon(uint16x8_t r, uint16x8_t g, uint16x8_t b,
+                                    int16_t cr, int16_t cg, int16_t cb)
+{
+    int16x8_t sum = vmulq_n_s16(vreinterpretq_s16_u16(r), cr);
+    sum = vmlaq_n_s16(sum, vreinterpretq_s16_u16(g), cg);
+    sum = vmlaq_n_s16(sum, vreinterpretq_s16_u16(b), cb);
+    sum = vaddq_s16(sum, vdupq_n_s16(128));
+    return vqmovun_s16(vaddq_s16(vshrq_n_s16(sum, 8), vdupq_n_s16(128)));
+}
+
+// Processes columns [2, x_end) in steps of 16 and returns x_end.
+static int demosaic_rows_neon(const unsigned char *ra, const unsigned char *rt,
+                              const unsigned char *rb, const unsigned char *rc,
+                              int width, bool swap_rb,
+                              unsigned char *y0, unsigned char *y1,
+                              unsigned char *u, unsigned char *v)
+{
+    int x = 2;
+    for (; x + 18 <= width; x += 16) {
+        Split128 a_l = load_split(ra + x - 2), a = load_split(ra + x);
+        Split128 t_l = load_split(rt + x - 2), t = load_split(rt + x), t_r = load_split(rt + x + 2);
+        Split128 b_l = load_split(rb + x - 2), b = load_split(rb + x), b_r = load_split(rb + x + 2);
+        Split128 c = load_split(rc + x), c_r = load_split(rc + x + 2);
+
+        uint16x8_t r_tl = t.e;
+        uint16x8_t g_tl = avg4(t_l.o, t.o, a.e, b.e);
+        uint16x8_t b_tl = avg4(a_l.o, a.o, b_l.o, b.o);
+        uint16x8_t r_tr = vrhaddq_u16(t.e, t_r.e);
+        uint16x8_t g_tr = t.o;
+        uint16x8_t b_tr = vrhaddq_u16(a.o, b.o);
+        uint16x8_t r_bl = vrhaddq_u16(t.e, c.e);
+        uint16x8_t g_bl = b.e;
+        uint16x8_t b_bl = vrhaddq_u16(b_l.o, b.o);
+        uint16x8_t r_br = avg4(t.e, t_r.e, c.e, c_r.e);
+        uint16x8_t g_br = avg4(b.e, b_r.e, t.o, c.o);
+        uint16x8_t b_br = b.o;
+
+        if (swap_rb) {
+            uint16x8_t tmp;
+            tmp = r_tl; r_tl = b_tl; b_tl = tmp;
+            tmp = r_tr; r_tr = b_tr; b_tr = tmp;
+            tmp = r_bl; r_bl = b_bl; b_bl = tmp;
+            tmp = r_br; r_br = b_br; b_br = tmp;
+        }
+
+        uint8x8x2_t top, bottom;
+        top.val[0] = luma_neon(r_tl, g_tl, b_tl);
+        top.val[1] = luma_neon(r_tr, g_tr, b_tr);
+        bottom.val[0] = luma_neon(r_bl, g_bl, b_bl);
+        bottom.val[1] = luma_neon(r_br, g_br, b_br);
+        vst2_u8(y0 + x, top);
+        vst2_u8(y1 + x, bottom);
+
+        uint16x8_t r = avg4(r_tl, r_tr, r_bl, r_br);
+        uint16x8_t g = avg4(g_tl, g_tr, g_bl, g_br);
+        uint16x8_t bl = avg4(b_tl, b_tr, b_bl, b_br);
+        vst1_u8(u + x / 2, chroma_neon(r, g, bl, -38, -74, 112));
+        vst1_u8(v + x / 2, chroma_neon(r, g, bl, 112, -94, -18));
+    }
+    return x;
+}
+
+static const bool have_simd = true;
+
+#define demosaic_rows_simd demosaic_rows_neon
+
+#endif
+
+const char *bayer_simd_name()
+{
+#if defined(BAYER_X86)
+    return have_simd ? "avx2" : "scalar";
+#elif defined(BAYER_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+void bayer_to_i420(const unsigned char *raw, int width, int height, int stride,
+                   BayerPattern pattern, unsigned char *i420)
+{
+#if defined(BAYER_X86) || defined(BAYER_NEON)
+    // The SIMD kernels assume red and blue share rows with green on odd columns.
+    if (have_simd && (pattern == BAYER_RGGB || pattern == BAYER_BGGR)) {
+        unsigned char *y_plane = i420;
+        unsigned char *u_plane = y_plane + width * height;
+        unsigned char *v_plane = u_plane + (width / 2) * (height / 2);
+        const bool swap_rb = pattern == BAYER_BGGR;
+        for (int y = 0; y < height; y += 2) {
+            const unsigned char *ra = raw + reflect(y - 1, height) * stride;
+            const unsigned char *rt = raw + y * stride;
+            const unsigned char *rb = raw + (y + 1) * stride;
+            const unsigned char *rc = raw + reflect(y + 2, height) * stride;
+            unsigned char *y0 = y_plane + y * width;
+            int x_end = demosaic_rows_simd(ra, rt, rb, rc, width, swap_rb, y0, y0 + width,
+                                           u_plane + (y / 2) * (width / 2), v_plane + (y / 2) * (width / 2));
+            // First block and the tail need reflected neighbours.
+            demosaic_block_range_scalar(raw, width, height, stride, pattern, y, 0, 2, y_plane, u_plane, v_plane);
+            demosaic_block_range_scalar(raw, width, height, stride, pattern, y, x_end, width, y_plane, u_plane, v_plane);
+        }
+        return;
+    }
+#endif
+    bayer_to_i420_scalar(raw, width, height, stride, pattern, i420);
+}
@@ -0,0 +1,38 @@
+// bayer.h : Bayer RAW8 demosaic straight into I420
+//
+// Replaces rawImage.Convert(...) followed by videoconvert for colour sensors:
+// one pass from the sensor mosaic to the planar YUV x264enc consumes.
+// BT.601 limited range, same coefficients as videoconvert's default.
+//
+// Output is contiguous I420 (Y, then U, then V) with GStreamer's default
+// strides, which requires width to be a multiple of 8 and height even
+// (16 and a multiple of 4 for half size).
+
+#pragma once
+
+enum BayerPattern {
+    BAYER_RGGB,
+    BAYER_BGGR,
+    BAYER_GRBG,
+    BAYER_GBRG
+};
+
+// Bytes of a contiguous I420 frame.
+unsigned int i420_size(int width, int height);
+
+// Full resolution bilinear demosaic. Uses AVX2 or NEON when available for
+// RGGB/BGGR sensors, scalar code otherwise.
+void bayer_to_i420(const unsigned char *raw, int width, int height, int stride,
+                   BayerPattern pattern, unsigned char *i420);
+
+// Scalar reference for bayer_to_i420, bit-exact with the SIMD paths.
+void bayer_to_i420_scalar(const unsigned char *raw, int width, int height, int stride,
+                          BayerPattern pattern, unsigned char *i420);
+
+// Half resolution: every 2x2 Bayer quad becomes one pixel, no interpolation.
+// Output is (width / 2) x (height / 2).
+void bayer_to_i420_half(const unsigned char *raw, int width, int height, int stride,
+                        BayerPattern pattern, unsigned char *i420);
+
+// "avx2", "neon" or "scalar", for logs and benchmark labels.
+const char *bayer_simd_name();
@@ -0,0 +1,227 @@
+// Per-frame hot path microbenchmarks (Google Benchmark).
+//
+// Every benchmark takes the frame size as {width, height} arguments so x86 dev
+// machines and the Pi can be compared kernel by kernel:
+//
+//   ./MicroBench --benchmark_format=json --benchmark_out=micro_$(uname -m).json
+#include <vector>
+#include <random>
+#include <cstring>
+#include <sys/utsname.h>
+#include <benchmark/benchmark.h>
+#include "FlyCapture2.h"
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include "../bayer.h"
+#include "../frame_pool.h"
+using namespace FlyCapture2;
+using namespace std;
+
+static void FrameSizes(benchmark::internal::Benchmark *b)
+{
+    b->Args({640, 480})->Args({1280, 1024})->Args({1920, 1080});
+}
+
+static vector<unsigned char> random_bytes(size_t size)
+{
+    vector<unsigned char> data(size);
+    mt19937 rng(42);
+    for (size_t i = 0; i < size; ++i)
+        data[i] = static_cast<unsigned char>(rng());
+    return data;
+}
+
+// ===================== Capture side =====================
+
+// Main's rawImage.Convert(PIXEL_FORMAT_MONO8, ...) on a RAW8 Bayer frame.
+static void BM_ConvertMono8(benchmark::State &state)
+{
+    const unsigned int width = state.range(0), height = state.range(1);
+    vector<unsigned char> raw = random_bytes(width * height);
+    Image rawImage(height, width, width, raw.data(), width * height, PIXEL_FORMAT_RAW8, RGGB);
+    Image convertedImage;
+    for (auto _ : state) {
+        Error error = rawImage.Convert(PIXEL_FORMAT_MONO8, &convertedImage);
+        if (error != PGRERROR_OK) {
+            state.SkipWithError("Convert failed");
+            break;
+        }
+        benchmark::DoNotOptimize(convertedImage.GetData());
+    }
+    state.SetBytesProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_ConvertMono8)->Apply(FrameSizes);
+
+// SDK colour path: generic demosaic to RGB8, which videoconvert then turns into I420.
+static void BM_ConvertRgb8(benchmark::State &state)
+{
+    const unsigned int width = state.range(0), height = state.range(1);
+    vector<unsigned char> raw = random_bytes(width * height);
+    Image rawImage(height, width, width, raw.data(), width * height, PIXEL_FORMAT_RAW8, RGGB);
+    Image convertedImage;
+    for (auto _ : state) {
+        Error error = rawImage.Convert(PIXEL_FORMAT_RGB8, &convertedImage);
+        if (error != PGRERROR_OK) {
+            state.SkipWithError("Convert failed");
+            break;
+        }
+        benchmark::DoNotOptimize(convertedImage.GetData());
+    }
+    state.SetBytesProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_ConvertRgb8)->Apply(FrameSizes);
+
+// Main's --color bayer path, SIMD when the CPU has it.
+static void BM_BayerToI420(benchmark::State &state)
+{
+    const int width = state.range(0), height = state.range(1);
+    vector<unsigned char> raw = random_bytes(width * height);
+    vector<unsigned char> i420(i420_size(width, height));
+    state.SetLabel(bayer_simd_name());
+    for (auto _ : state) {
+        bayer_to_i420(raw.data(), width, height, width, BAYER_RGGB, i420.data());
+        benchmark::DoNotOptimize(i420.data());
+    }
+    state.SetBytesProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_BayerToI420)->Apply(FrameSizes);
+
+static void BM_BayerToI420Scalar(benchmark::State &state)
+{
+    const int width = state.range(0), height = state.range(1);
+    vector<unsigned char> raw = random_bytes(width * height);
+    vector<unsigned char> i420(i420_size(width, height));
+    for (auto _ : state) {
+        bayer_to_i420_scalar(raw.data(), width, height, width, BAYER_RGGB, i420.data());
+        benchmark::DoNotOptimize(i420.data());
+    }
+    state.SetBytesProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_BayerToI420Scalar)->Apply(FrameSizes);
+
+// Main's --color bayer-half path.
+static void BM_BayerToI420Half(benchmark::State &state)
+{
+    const int width = state.range(0), height = state.range(1);
+    vector<unsigned char> raw = random_bytes(width * height);
+    vector<unsigned char> i420(i420_size(width / 2, height / 2));
+    for (auto _ : state) {
+        bayer_to_i420_half(raw.data(), width, height, width, BAYER_RGGB, i420.data());
+        benchmark::DoNotOptimize(i420.data());
+    }
+    state.SetBytesProcessed(state.iterations() * width * height);
+}
+BENCHMARK(BM_BayerToI420Half)->Apply(FrameSizes);
+
+// Main's path before the frame pool: allocate a GstBuffer and copy the frame
+// into it.
+static void BM_GstBufferAllocateFill(benchmark::State &state)
+{
+    const size_t size = state.range(0) * state.range(1);
+    vector<unsigned char> frame = random_bytes(size);
+    for (auto _ : state) {
+        GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
+        gst_buffer_fill(buffer, 0, frame.data(), size);
+        gst_buffer_unref(buffer);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_GstBufferAllocateFill)->Apply(FrameSizes);
+
+// Main's current path: the frame is converted straight into pool memory, so
+// only acquiring the wrapped buffer and returning it on unref remain. Nothing
+// is copied, compare time per frame rather than bytes/s.
+static void BM_FramePoolAcquire(benchmark::State &state)
+{
+    const size_t size = state.range(0) * state.range(1);
+    FramePool pool(size, 8);
+    pool.prefault();
+    for (auto _ : state) {
+        unsigned char *data = nullptr;
+        GstBuffer *buffer = pool.acquire(&data);
+        benchmark::DoNotOptimize(data);
+        gst_buffer_unref(buffer);
+    }
+}
+BENCHMARK(BM_FramePoolAcquire)->Apply(FrameSizes);
+
+// Lower bound for any zero-copy scheme: wrap existing frame memory.
+static void BM_GstBufferWrap(benchmark::State &state)
+{
+    const size_t size = state.range(0) * state.range(1);
+    vector<unsigned char> frame = random_bytes(size);
+    for (auto _ : state) {
+        GstBuffer *buffer = gst_buffer_new_wrapped_full(
+            GST_MEMORY_FLAG_READONLY, frame.data(), size, 0, size, NULL, NULL);
+        gst_buffer_unref(buffer);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_GstBufferWrap)->Apply(FrameSizes);
+
+// gst_app_src_push_buffer into a fakesink, including the streaming thread hand-off.
+static void BM_AppSrcPush(benchmark::State &state)
+{
+    const int width = state.range(0), height = state.range(1);
+    const size_t size = static_cast<size_t>(width) * height;
+    vector<unsigned char> frame = random_bytes(size);
+
+    GstElement *pipeline = gst_parse_launch(
+        "appsrc name=src format=time is-live=true block=true ! fakesink sync=false", nullptr);
+    if (!pipeline) {
+        state.SkipWithError("Failed to create pipeline");
+        return;
+    }
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+        "format", G_TYPE_STRING, "GRAY8",
+        "width", G_TYPE_INT, width,
+        "height", G_TYPE_INT, height,
+        "framerate", GST_TYPE_FRACTION, 30, 1,
+        NULL);
+    gst_app_src_set_caps(GST_APP_SRC(appsrc), caps);
+    gst_caps_unref(caps);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstClockTime timestamp = 0;
+    const GstClockTime duration = GST_SECOND / 30;
+    for (auto _ : state) {
+        GstBuffer *buffer = gst_buffer_new_wrapped_full(
+            GST_MEMORY_FLAG_READONLY, frame.data(), size, 0, size, NULL, NULL);
+        GST_BUFFER_PTS(buffer) = timestamp;
+        GST_BUFFER_DURATION(buffer) = duration;
+        timestamp += duration;
+        if (gst_app_src_push_buffer(GST_APP_SRC(appsrc), buffer) != GST_FLOW_OK) {
+            state.SkipWithError("Push failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(appsrc);
+    gst_object_unref(pipeline);
+}
+BENCHMARK(BM_AppSrcPush)->Apply(FrameSizes)->UseRealTime();
+
+int main(int argc, char **argv)
+{
+    gst_init(&argc, &argv);
+    gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    // Tag results so JSON from different boards can be told apart.
+    struct utsname host;
+    if (uname(&host) == 0) {
+        benchmark::AddCustomContext("machine", host.machine);
+        benchmark::AddCustomContext("kernel", host.release);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
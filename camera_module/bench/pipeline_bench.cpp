@@ -0,0 +1,531 @@
+// End-to-end pipeline benchmark.
+//
+// Drives the same encoder chain as Main from a synthetic GRAY8 source, sends it
+// over loopback UDP and decodes it again in the same process:
+//
+//   source -> [enc] videoconvert ! x264enc ! rtph264pay -> [net] udpsink or batchudpsink
+//          -> [rx] udpsrc ! rtph264depay -> [dec] avdec_h264 ! appsink
+//
+// Every stage in brackets runs on its own streaming thread (queues), so CPU can
+// be attributed per stage from /proc/self/task. Each frame carries its index in
+// a block pattern so the receiver can compute glass-to-glass latency. Packets
+// reaching the sink are counted so sinks can be compared in packets/s and send
+// CPU per packet.
+//
+// One configuration per run, result printed as a single JSON line on stdout.
+// See run_pipeline_bench.py for sweeps and baseline comparison.
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
+#include "../batch_udp_sink.h"
+using namespace std;
+
+// Frame index is stamped as BITS blocks of BLOCK x BLOCK pixels in the top-left
+// corner: 20 bits of index followed by a 4 bit checksum.
+static const int BLOCK = 16;
+static const int INDEX_BITS = 20;
+static const int CHECK_BITS = 4;
+static const int BITS = INDEX_BITS + CHECK_BITS;
+
+// Main streams at 30 fps. Unpaced runs keep its timestamps, x264 rate control
+// budgets bits per frame from them.
+static const int MAIN_FPS = 30;
+
+struct BenchOptions {
+    int width = 1280;
+    int height = 1024;
+    int fps = MAIN_FPS;     // 0 = push as fast as the pipeline accepts
+    int frames = 300;
+    int warmup = 30;        // frames excluded from fps/latency/cpu figures
+    int bitrate = 2048;     // kbit/s
+    string preset = "ultrafast";
+    string sink = "udpsink";
+    int max_rate = 0;       // batchudpsink pacing, kbit/s
+    int port = 5600;
+};
+
+static void PrintUsage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [options]" << endl
+         << "  --width N       frame width (default 1280)" << endl
+         << "  --height N      frame height (default 1024)" << endl
+         << "  --fps N         source frame rate, 0 = unpaced at 30 fps timestamps (default 30)" << endl
+         << "  --frames N      frames to send (default 300)" << endl
+         << "  --warmup N      frames ignored in results (default 30)" << endl
+         << "  --bitrate N     x264enc bitrate in kbit/s (default 2048)" << endl
+         << "  --preset NAME   x264enc speed-preset (default ultrafast)" << endl
+         << "  --sink NAME     udpsink or batchudpsink (default udpsink)" << endl
+         << "  --max-rate N    batchudpsink pacing in kbit/s, 0 = off (default 0)" << endl
+         << "  --port N        loopback UDP port (default 5600)" << endl;
+}
+
+static bool parse_options(int argc, char *argv[], BenchOptions &opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--width") opts.width = stoi(value);
+        else if (arg == "--height") opts.height = stoi(value);
+        else if (arg == "--fps") opts.fps = stoi(value);
+        else if (arg == "--frames") opts.frames = stoi(value);
+        else if (arg == "--warmup") opts.warmup = stoi(value);
+        else if (arg == "--bitrate") opts.bitrate = stoi(value);
+        else if (arg == "--preset") opts.preset = value;
+        else if (arg == "--sink") opts.sink = value;
+        else if (arg == "--max-rate") opts.max_rate = stoi(value);
+        else if (arg == "--port") opts.port = stoi(value);
+        else {
+            cerr << "Unknown option: " << arg << endl;
+            return false;
+        }
+    }
+    if (opts.width < BITS * BLOCK || opts.height < BLOCK) {
+        cerr << "Frame must be at least " << BITS * BLOCK << "x" << BLOCK << endl;
+        return false;
+    }
+    if (opts.width % 4 != 0) {
+        cerr << "--width must be a multiple of 4" << endl;
+        return false;
+    }
+    if (opts.warmup >= opts.frames) {
+        cerr << "--warmup must be smaller than --frames" << endl;
+        return false;
+    }
+    return true;
+}
+
+static int64_t now_ns()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ===================== Frame index stamping =====================
+
+static unsigned int checksum(unsigned int index)
+{
+    unsigned int sum = 0;
+    for (int b = 0; b < INDEX_BITS; b += CHECK_BITS)
+        sum += (index >> b) & ((1u << CHECK_BITS) - 1);
+    return sum & ((1u << CHECK_BITS) - 1);
+}
+
+static void stamp_index(unsigned char *frame, int stride, unsigned int index)
+{
+    unsigned int code = (index & ((1u << INDEX_BITS) - 1)) | (checksum(index) << INDEX_BITS);
+    for (int bit = 0; bit < BITS; ++bit) {
+        unsigned char value = ((code >> bit) & 1) ? 255 : 0;
+        for (int y = 0; y < BLOCK; ++y)
+            memset(frame + y * stride + bit * BLOCK, value, BLOCK);
+    }
+}
+
+static bool read_index(const unsigned char *frame, int stride, unsigned int *index)
+{
+    unsigned int code = 0;
+    for (int bit = 0; bit < BITS; ++bit) {
+        if (frame[(BLOCK / 2) * stride + bit * BLOCK + BLOCK / 2] > 127)
+            code |= 1u << bit;
+    }
+    *index = code & ((1u << INDEX_BITS) - 1);
+    return (code >> INDEX_BITS) == checksum(*index);
+}
+
+// ===================== Per-thread CPU accounting =====================
+
+// Streaming threads are named "<element>:<pad>" by GstTask and x264's worker
+// threads inherit the name of the thread that created them, so summing
+// utime+stime by thread name gives CPU per stage including encoder workers.
+typedef map<string, unsigned long long> CpuByThread;
+
+static CpuByThread sample_thread_cpu()
+{
+    CpuByThread ticks;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir)
+        return ticks;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.')
+            continue;
+        ifstream stat(string("/proc/self/task/") + entry->d_name + "/stat");
+        string line;
+        if (!getline(stat, line))
+            continue;
+        size_t open = line.find('(');
+        size_t close = line.rfind(')');
+        if (open == string::npos || close == string::npos)
+            continue;
+        string name = line.substr(open + 1, close - open - 1);
+        istringstream fields(line.substr(close + 2));
+        string skip;
+        // Fields 3..13 precede utime (14) and stime (15).
+        for (int f = 3; f <= 13; ++f)
+            fields >> skip;
+        unsigned long long utime = 0, stime = 0;
+        fields >> utime >> stime;
+        ticks[name] += utime + stime;
+    }
+    closedir(dir);
+    return ticks;
+}
+
+static string stage_of_thread(const string &name)
+{
+    if (name == "source" || name.compare(0, 4, "src:") == 0) return "source";
+    if (name.compare(0, 4, "enc:") == 0) return "encode";
+    if (name.compare(0, 4, "net:") == 0) return "send";
+    if (name.compare(0, 3, "rx:") == 0) return "receive";
+    if (name.compare(0, 4, "dec:") == 0) return "decode";
+    return "other";
+}
+
+// ===================== Receiver =====================
+
+struct Receiver {
+    vector<atomic<int64_t>> *send_times;
+    int warmup;
+    int stride;
+    atomic<int> received;
+    atomic<int64_t> first_ns;
+    atomic<int64_t> last_ns;
+    vector<double> latencies_ms;   // only touched from the appsink thread
+    int corrupt;
+};
+
+static GstFlowReturn on_new_sample(GstAppSink *sink, gpointer user_data)
+{
+    Receiver *rx = static_cast<Receiver *>(user_data);
+    GstSample *sample = gst_app_sink_pull_sample(sink);
+    if (!sample)
+        return GST_FLOW_ERROR;
+
+    int64_t arrival = now_ns();
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        unsigned int index;
+        if (read_index(map.data, rx->stride, &index) && index < rx->send_times->size()) {
+            int64_t sent = (*rx->send_times)[index].load();
+            if (sent > 0 && static_cast<int>(index) >= rx->warmup) {
+                rx->latencies_ms.push_back((arrival - sent) / 1e6);
+                if (rx->first_ns.load() == 0)
+                    rx->first_ns = arrival;
+                rx->last_ns = arrival;
+            }
+        } else {
+            rx->corrupt++;
+        }
+        gst_buffer_unmap(buffer, &map);
+    }
+    rx->received++;
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+// ===================== Sender =====================
+
+// Datagrams reaching the network sink, whether pushed one by one or as lists
+static GstPadProbeReturn count_packets(GstPad *, GstPadProbeInfo *info, gpointer user_data)
+{
+    atomic<uint64_t> *packets = static_cast<atomic<uint64_t> *>(user_data);
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+        *packets += gst_buffer_list_length(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+    else
+        (*packets)++;
+    return GST_PAD_PROBE_OK;
+}
+
+// Send syscalls so far, -1 when the sink doesn't count them (udpsink)
+static int64_t sink_syscalls(GstElement *sink)
+{
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(sink), "syscalls"))
+        return -1;
+    guint64 syscalls = 0;
+    g_object_get(sink, "syscalls", &syscalls, NULL);
+    return static_cast<int64_t>(syscalls);
+}
+
+static double percentile(vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[min(rank, values.size() - 1)];
+}
+
+static bool pipeline_failed(GstElement *pipeline, const char *what)
+{
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+    gst_object_unref(bus);
+    if (!msg)
+        return false;
+    GError *err = nullptr;
+    gst_message_parse_error(msg, &err, nullptr);
+    cerr << what << " error: " << (err ? err->message : "unknown") << endl;
+    if (err) g_error_free(err);
+    gst_message_unref(msg);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    gst_init(&argc, &argv);
+    gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+    batch_udp_sink_register();
+
+    BenchOptions opts;
+    if (!parse_options(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    pthread_setname_np(pthread_self(), "source");
+
+    const int stride = opts.width;   // GRAY8 rows are 4-byte aligned, width is checked above
+    const size_t frame_size = static_cast<size_t>(opts.width) * opts.height;
+
+    // Receiver: started first so no packets are lost to a closed port.
+    ostringstream rx_str;
+    rx_str << "udpsrc name=rx port=" << opts.port << " buffer-size=4194304 "
+           << "caps=\"application/x-rtp,media=(string)video,encoding-name=(string)H264,"
+           << "payload=(int)96,clock-rate=(int)90000\" ! "
+           << "rtph264depay ! queue name=dec ! avdec_h264 ! "
+           << "appsink name=out caps=video/x-raw,format=I420 sync=false";
+    GError *gerror = nullptr;
+    GstElement *receiver = gst_parse_launch(rx_str.str().c_str(), &gerror);
+    if (!receiver) {
+        cerr << "Failed to create receiver: " << (gerror ? gerror->message : "unknown") << endl;
+        if (gerror) g_error_free(gerror);
+        return -1;
+    }
+
+    vector<atomic<int64_t>> send_times(opts.frames);
+    Receiver rx;
+    rx.send_times = &send_times;
+    rx.warmup = opts.warmup;
+    rx.stride = stride;   // I420 luma plane has the same stride for 4-aligned widths
+    rx.received = 0;
+    rx.first_ns = 0;
+    rx.last_ns = 0;
+    rx.corrupt = 0;
+    rx.latencies_ms.reserve(opts.frames);
+
+    GstElement *appsink = gst_bin_get_by_name(GST_BIN(receiver), "out");
+    GstAppSinkCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.new_sample = on_new_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks, &rx, nullptr);
+    gst_element_set_state(receiver, GST_STATE_PLAYING);
+
+    // Sender: same encoder chain as Main's create_udp_lossless_pipeline.
+    const int stamp_fps = opts.fps > 0 ? opts.fps : MAIN_FPS;
+    ostringstream tx_str;
+    tx_str << "appsrc name=src format=time is-live=true block=true max-bytes=" << frame_size * 4 << " "
+           << "caps=video/x-raw,format=GRAY8,width=" << opts.width << ",height=" << opts.height
+           << ",framerate=" << stamp_fps << "/1 ! "
+           << "queue name=enc ! videoconvert ! video/x-raw,format=I420 ! "
+           << "x264enc tune=zerolatency speed-preset=" << opts.preset << " bitrate=" << opts.bitrate << " ! "
+           << "rtph264pay config-interval=1 ! "
+           << "queue name=net ! "
+           << opts.sink << " name=netsink host=127.0.0.1 port=" << opts.port << " sync=false async=false";
+    if (opts.max_rate > 0)
+        tx_str << " max-rate=" << opts.max_rate;
+    GstElement *sender = gst_parse_launch(tx_str.str().c_str(), &gerror);
+    if (!sender) {
+        cerr << "Failed to create sender: " << (gerror ? gerror->message : "unknown") << endl;
+        if (gerror) g_error_free(gerror);
+        gst_element_set_state(receiver, GST_STATE_NULL);
+        gst_object_unref(appsink);
+        gst_object_unref(receiver);
+        return -1;
+    }
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(sender), "src");
+    GstElement *netsink = gst_bin_get_by_name(GST_BIN(sender), "netsink");
+    atomic<uint64_t> packets(0);
+    GstPad *netsink_pad = gst_element_get_static_pad(netsink, "sink");
+    gst_pad_add_probe(netsink_pad,
+                      static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                      count_packets, &packets, nullptr);
+    gst_object_unref(netsink_pad);
+    gst_element_set_state(sender, GST_STATE_PLAYING);
+
+    // Synthetic content: a textured plane panned by a few pixels per frame so
+    // the encoder has real motion to estimate.
+    const int pan = 4;
+    const int tex_width = opts.width * 2;
+    vector<unsigned char> texture(static_cast<size_t>(tex_width) * opts.height);
+    unsigned int seed = 12345;
+    for (int y = 0; y < opts.height; ++y) {
+        for (int x = 0; x < tex_width; ++x) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned char noise = (seed >> 24) & 0x1f;
+            texture[static_cast<size_t>(y) * tex_width + x] =
+                static_cast<unsigned char>(((x / 32 + y / 32) % 2 ? 160 : 64) + noise);
+        }
+    }
+
+    const GstClockTime duration = GST_SECOND / stamp_fps;
+    GstClockTime timestamp = 0;
+    CpuByThread cpu_start;
+    uint64_t packets_start = 0;
+    int64_t syscalls_start = 0;
+    int64_t wall_start = 0;
+    int64_t send_start = 0;
+    int64_t send_end = 0;
+    int sent = 0;
+    auto next_frame = chrono::steady_clock::now();
+    bool failed = false;
+
+    for (int i = 0; i < opts.frames; ++i) {
+        if (i == opts.warmup) {
+            cpu_start = sample_thread_cpu();
+            packets_start = packets.load();
+            syscalls_start = sink_syscalls(netsink);
+            wall_start = now_ns();
+            send_start = wall_start;
+        }
+
+        GstBuffer *buffer = gst_buffer_new_allocate(NULL, frame_size, NULL);
+        GstMapInfo map;
+        gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+        size_t offset = static_cast<size_t>(i) * pan % opts.width;
+        for (int y = 0; y < opts.height; ++y)
+            memcpy(map.data + static_cast<size_t>(y) * stride,
+                   &texture[static_cast<size_t>(y) * tex_width + offset], opts.width);
+        stamp_index(map.data, stride, i);
+        gst_buffer_unmap(buffer, &map);
+
+        GST_BUFFER_PTS(buffer) = timestamp;
+        GST_BUFFER_DURATION(buffer) = duration;
+        timestamp += duration;
+
+        send_times[i] = now_ns();
+        if (gst_app_src_push_buffer(GST_APP_SRC(appsrc), buffer) != GST_FLOW_OK) {
+            cerr << "Error pushing buffer " << i << endl;
+            failed = true;
+            break;
+        }
+        sent++;
+
+        if (opts.fps > 0) {
+            next_frame += chrono::nanoseconds(1000000000LL / opts.fps);
+            this_thread::sleep_until(next_frame);
+        }
+        if (pipeline_failed(sender, "Sender") || pipeline_failed(receiver, "Receiver")) {
+            failed = true;
+            break;
+        }
+    }
+    send_end = now_ns();
+    gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+
+    // Drain: wait until everything arrived or nothing new shows up for a second.
+    int last_count = -1;
+    auto idle_since = chrono::steady_clock::now();
+    while (rx.received.load() < sent) {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        int count = rx.received.load();
+        if (count != last_count) {
+            last_count = count;
+            idle_since = chrono::steady_clock::now();
+        } else if (chrono::steady_clock::now() - idle_since > chrono::seconds(1)) {
+            break;
+        }
+    }
+
+    CpuByThread cpu_end = sample_thread_cpu();
+    const uint64_t measured_packets = packets.load() - packets_start;
+    const int64_t syscalls_end = sink_syscalls(netsink);
+    // The window ends with the last decoded frame (or the last push if none
+    // arrived), so the drain wait and its idle timeout don't dilute the rates.
+    // CPU is sampled after the drain, which only adds the idle wait.
+    const int64_t wall_end = max(rx.last_ns.load(), send_end);
+
+    gst_element_set_state(sender, GST_STATE_NULL);
+    gst_element_set_state(receiver, GST_STATE_NULL);
+    gst_object_unref(appsrc);
+    gst_object_unref(netsink);
+    gst_object_unref(sender);
+    gst_object_unref(appsink);
+    gst_object_unref(receiver);
+
+    if (failed)
+        return -1;
+
+    // Stage CPU and packet rate over the measured window.
+    const double tick_ms = 1000.0 / sysconf(_SC_CLK_TCK);
+    const double wall_ms = (wall_end - wall_start) / 1e6;
+    const int measured_sent = max(sent - opts.warmup, 1);
+    map<string, double> cpu_ms;
+    const char *stages[] = {"source", "encode", "send", "receive", "decode", "other"};
+    for (const char *stage : stages)
+        cpu_ms[stage] = 0.0;
+    for (CpuByThread::const_iterator it = cpu_end.begin(); it != cpu_end.end(); ++it) {
+        unsigned long long before = cpu_start.count(it->first) ? cpu_start[it->first] : 0;
+        if (it->second > before)
+            cpu_ms[stage_of_thread(it->first)] += (it->second - before) * tick_ms;
+    }
+
+    int measured_received = static_cast<int>(rx.latencies_ms.size());
+    double recv_span_s = (rx.last_ns.load() - rx.first_ns.load()) / 1e9;
+    double recv_fps = (measured_received > 1 && recv_span_s > 0) ? (measured_received - 1) / recv_span_s : 0.0;
+    double send_fps = send_end > send_start ? measured_sent / ((send_end - send_start) / 1e9) : 0.0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    ostringstream json;
+    json.setf(ios::fixed);
+    json.precision(3);
+    json << "{\"width\":" << opts.width
+         << ",\"height\":" << opts.height
+         << ",\"fps_target\":" << opts.fps
+         << ",\"preset\":\"" << opts.preset << "\""
+         << ",\"bitrate_kbps\":" << opts.bitrate
+         << ",\"sink\":\"" << opts.sink << "\""
+         << ",\"max_rate_kbps\":" << opts.max_rate
+         << ",\"frames_sent\":" << sent
+         << ",\"frames_received\":" << rx.received.load()
+         << ",\"frames_corrupt\":" << rx.corrupt
+         << ",\"send_fps\":" << send_fps
+         << ",\"recv_fps\":" << recv_fps
+         << ",\"packets_per_frame\":" << static_cast<double>(measured_packets) / measured_sent
+         << ",\"packets_per_s\":" << measured_packets / (wall_ms / 1000.0)
+         << ",\"syscalls_per_frame\":"
+         << (syscalls_start >= 0 ? static_cast<double>(syscalls_end - syscalls_start) / measured_sent : -1.0)
+         << ",\"latency_ms\":{\"p50\":" << percentile(rx.latencies_ms, 50)
+         << ",\"p90\":" << percentile(rx.latencies_ms, 90)
+         << ",\"p99\":" << percentile(rx.latencies_ms, 99)
+         << ",\"max\":" << percentile(rx.latencies_ms, 100) << "}"
+         << ",\"cpu_percent\":{";
+    for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); ++s)
+        json << (s ? "," : "") << "\"" << stages[s] << "\":" << 100.0 * cpu_ms[stages[s]] / wall_ms;
+    json << "},\"cpu_ms_per_frame\":{";
+    for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); ++s)
+        json << (s ? "," : "") << "\"" << stages[s] << "\":" << cpu_ms[stages[s]] / measured_sent;
+    json << "},\"max_rss_kb\":" << usage.ru_maxrss << "}";
+    cout << json.str() << endl;
+    return 0;
+}
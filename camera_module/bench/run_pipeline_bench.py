@@ -0,0 +1,156 @@
+"""
+Sweep PipelineBench over resolution, encoder preset, bitrate and UDP sink.
+
+Each configuration runs in its own process (so max RSS is per configuration)
+and the JSON lines it prints are collected into one results file. Passing a
+previous results file as --baseline flags regressions and exits non-zero.
+
+    python run_pipeline_bench.py --bench build/PipelineBench --out bench.json
+    python run_pipeline_bench.py --bench build/PipelineBench --baseline bench.json
+    python run_pipeline_bench.py --sinks udpsink,batchudpsink --bitrates 8192,32768
+"""
+import argparse
+import json
+import platform
+import subprocess
+import sys
+import time
+
+
+def run_config(bench, width, height, preset, bitrate, sink, args):
+    cmd = [
+        bench,
+        "--width", str(width),
+        "--height", str(height),
+        "--preset", preset,
+        "--bitrate", str(bitrate),
+        "--fps", str(args.fps),
+        "--frames", str(args.frames),
+        "--warmup", str(args.warmup),
+        "--sink", sink,
+        "--max-rate", str(args.max_rate),
+        "--port", str(args.port),
+    ]
+    proc = subprocess.run(cmd, capture_output=True, text=True)
+    if proc.returncode != 0:
+        print(f"[bench] {' '.join(cmd)} failed:\n{proc.stderr}", file=sys.stderr)
+        return None
+    lines = [line for line in proc.stdout.splitlines() if line.startswith("{")]
+    if not lines:
+        print(f"[bench] no result from {' '.join(cmd)}", file=sys.stderr)
+        return None
+    return json.loads(lines[-1])
+
+
+def config_key(result):
+    return (result["width"], result["height"], result["preset"], result["bitrate_kbps"], result["sink"])
+
+
+def compare(results, baseline, tolerance):
+    """
+    Compare against a previous run.
+    :return: list of human readable regressions.
+    """
+    previous = {config_key(r): r for r in baseline["results"]}
+    regressions = []
+    for result in results:
+        base = previous.get(config_key(result))
+        if base is None:
+            continue
+        name = "{}x{} {} {}kbps {}".format(*config_key(result))
+        if result["recv_fps"] < base["recv_fps"] * (1 - tolerance):
+            regressions.append(f"{name}: recv_fps {base['recv_fps']:.1f} -> {result['recv_fps']:.1f}")
+        if result["latency_ms"]["p99"] > base["latency_ms"]["p99"] * (1 + tolerance):
+            regressions.append(
+                f"{name}: p99 latency {base['latency_ms']['p99']:.1f} -> {result['latency_ms']['p99']:.1f} ms")
+        cpu, base_cpu = sum(result["cpu_ms_per_frame"].values()), sum(base["cpu_ms_per_frame"].values())
+        if cpu > base_cpu * (1 + tolerance):
+            regressions.append(f"{name}: cpu/frame {base_cpu:.2f} -> {cpu:.2f} ms")
+        if result["max_rss_kb"] > base["max_rss_kb"] * (1 + tolerance):
+            regressions.append(f"{name}: max rss {base['max_rss_kb']} -> {result['max_rss_kb']} kB")
+    return regressions
+
+
+def compare_sinks(results):
+    """
+    Send cost of every sink against udpsink for the same configuration.
+    :return: list of human readable lines.
+    """
+    by_config = {}
+    for result in results:
+        by_config.setdefault(config_key(result)[:4], {})[result["sink"]] = result
+    lines = []
+    for config, sinks in by_config.items():
+        base = sinks.get("udpsink")
+        if base is None:
+            continue
+        name = "{}x{} {} {}kbps".format(*config)
+        for sink, result in sinks.items():
+            if sink == "udpsink":
+                continue
+            base_send = base["cpu_ms_per_frame"]["send"]
+            send = result["cpu_ms_per_frame"]["send"]
+            change = f"{100 * (send - base_send) / base_send:+.0f}%" if base_send > 0 else "n/a"
+            lines.append(f"{name}: {sink} vs udpsink: send cpu/frame {base_send:.3f} -> {send:.3f} ms ({change}), "
+                         f"{result['packets_per_frame']:.0f} packets in {result['syscalls_per_frame']:.1f} syscalls/frame, "
+                         f"{base['packets_per_s']:.0f} -> {result['packets_per_s']:.0f} packets/s")
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bench", default="./PipelineBench", help="path to the PipelineBench executable")
+    parser.add_argument("--resolutions", default="640x480,1280x1024,1920x1080")
+    parser.add_argument("--presets", default="ultrafast,superfast,veryfast")
+    parser.add_argument("--bitrates", default="1024,2048,4096", help="kbit/s")
+    parser.add_argument("--sinks", default="udpsink", help="comma separated, e.g. udpsink,batchudpsink")
+    parser.add_argument("--max-rate", type=int, default=0, help="batchudpsink pacing in kbit/s, 0 = off")
+    parser.add_argument("--fps", type=int, default=30, help="0 = unpaced, frames still stamped at 30 fps")
+    parser.add_argument("--frames", type=int, default=300)
+    parser.add_argument("--warmup", type=int, default=30)
+    parser.add_argument("--port", type=int, default=5600)
+    parser.add_argument("--out", default="bench_results.json")
+    parser.add_argument("--baseline", help="results file from a previous build")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed relative regression")
+    args = parser.parse_args()
+
+    results = []
+    for resolution in args.resolutions.split(","):
+        width, height = (int(v) for v in resolution.split("x"))
+        for preset in args.presets.split(","):
+            for bitrate in (int(b) for b in args.bitrates.split(",")):
+                for sink in args.sinks.split(","):
+                    result = run_config(args.bench, width, height, preset, bitrate, sink, args)
+                    if result is None:
+                        continue
+                    print(f"[bench] {width}x{height} {preset} {bitrate}kbps {sink}: "
+                          f"{result['recv_fps']:.1f} fps, p99 {result['latency_ms']['p99']:.1f} ms, "
+                          f"cpu/frame {sum(result['cpu_ms_per_frame'].values()):.2f} ms, "
+                          f"{result['packets_per_s']:.0f} packets/s")
+                    results.append(result)
+
+    for line in compare_sinks(results):
+        print(f"[bench] {line}")
+
+    report = {
+        "timestamp": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "results": results,
+    }
+    with open(args.out, "w") as f:
+        json.dump(report, f, indent=2)
+    print(f"[bench] wrote {len(results)} results to {args.out}")
+
+    if args.baseline:
+        with open(args.baseline, "r") as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, args.tolerance)
+        for regression in regressions:
+            print(f"[bench] REGRESSION {regression}")
+        if regressions:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,246 @@
+#include "control_socket.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+
+vector<string> split_command(const string &line)
+{
+    vector<string> words;
+    istringstream in(line);
+    string word;
+    while (in >> word)
+        words.push_back(word);
+    return words;
+}
+
+ControlServer::ControlServer() : running_(false), pending_(0), listen_fd_(-1)
+{
+}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+void ControlServer::process(const Handler &handler)
+{
+    if (pending_.load(memory_order_acquire) == 0)
+        return;
+
+    deque<shared_ptr<Command>> commands;
+    {
+        lock_guard<mutex> lock(mutex_);
+        commands.swap(queue_);
+        pending_ = 0;
+    }
+    for (size_t i = 0; i < commands.size(); ++i) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (commands[i]->cancelled)
+                continue;
+            commands[i]->started = true;
+        }
+        string reply;
+        try {
+            reply = handler(commands[i]->args);
+        } catch (const logic_error &) {
+            reply = "error invalid number";
+        }
+        lock_guard<mutex> lock(mutex_);
+        commands[i]->reply = reply;
+        commands[i]->done = true;
+    }
+    done_cv_.notify_all();
+}
+
+// Queues a command and waits for the capture thread to run it.
+string ControlServer::submit(const vector<string> &args)
+{
+    shared_ptr<Command> command = make_shared<Command>();
+    command->args = args;
+    command->started = false;
+    command->done = false;
+    command->cancelled = false;
+
+    unique_lock<mutex> lock(mutex_);
+    queue_.push_back(command);
+    pending_.fetch_add(1, memory_order_release);
+    // RetrieveBuffer blocks for at most a frame, a paused or stopped camera longer
+    if (done_cv_.wait_for(lock, chrono::seconds(3), [&command] { return command->done; }))
+        return command->reply;
+
+    if (command->started) {
+        // Already being applied, its reply is the truth
+        done_cv_.wait(lock, [&command] { return command->done; });
+        return command->reply;
+    }
+    // Withdraw it, so a client that saw the error isn't surprised by it later
+    command->cancelled = true;
+    deque<shared_ptr<Command>>::iterator it = find(queue_.begin(), queue_.end(), command);
+    if (it != queue_.end()) {
+        queue_.erase(it);
+        pending_.fetch_sub(1, memory_order_release);
+    }
+    return "error capture loop did not respond, command not applied";
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+bool ControlServer::start(const string &path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        cerr << "Control: socket path must be 1-" << sizeof(addr.sun_path) - 1 << " characters" << endl;
+        return false;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        cerr << "Control: failed to create socket" << endl;
+        return false;
+    }
+    unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 2) != 0) {
+        cerr << "Control: failed to listen on " << path << " (" << strerror(errno) << ")" << endl;
+        ::close(fd);
+        return false;
+    }
+    // Owner and group only, the socket controls where the video goes
+    chmod(path.c_str(), 0660);
+
+    path_ = path;
+    listen_fd_ = fd;
+    running_ = true;
+    thread_ = thread(&ControlServer::run, this);
+    cout << "Control socket at " << path << endl;
+    return true;
+}
+
+void ControlServer::stop()
+{
+    if (!running_.exchange(false))
+        return;
+    if (thread_.joinable())
+        thread_.join();
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(path_.c_str());
+}
+
+static const size_t MAX_CLIENTS = 8;
+
+// Clients are multiplexed with poll(), a connection that never sends only
+// costs a slot. The 200 ms timeout is how stop() is noticed.
+void ControlServer::run()
+{
+    vector<Client> clients;
+    while (running_) {
+        vector<pollfd> fds(1 + clients.size());
+        fds[0].fd = listen_fd_;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds.data(), fds.size(), 200) <= 0)
+            continue;
+
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (fds[i + 1].revents == 0)
+                continue;
+            if (!serve(clients[i])) {
+                ::close(clients[i].fd);
+                clients.erase(clients.begin() + i);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            if (clients.size() >= MAX_CLIENTS) {
+                cerr << "Control: too many clients, refusing a connection" << endl;
+                ::close(fd);
+                continue;
+            }
+            // A client that stops reading its replies must not stall the others
+            timeval timeout;
+            timeout.tv_sec = 1;
+            timeout.tv_usec = 0;
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            Client client;
+            client.fd = fd;
+            clients.push_back(client);
+        }
+    }
+    for (size_t i = 0; i < clients.size(); ++i)
+        ::close(clients[i].fd);
+}
+
+bool ControlServer::serve(Client &client)
+{
+    char chunk[512];
+    ssize_t received = recv(client.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if (received == 0)
+        return false;
+    client.pending.append(chunk, static_cast<size_t>(received));
+
+    size_t newline;
+    while ((newline = client.pending.find('\n')) != string::npos) {
+        vector<string> args = split_command(client.pending.substr(0, newline));
+        client.pending.erase(0, newline + 1);
+        if (args.empty())
+            continue;
+        string reply = submit(args) + "\n";
+        if (send(client.fd, reply.data(), reply.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(reply.size()))
+            return false;
+    }
+    return client.pending.size() <= 4096;
+}
+
+#else
+
+bool ControlServer::start(const string &)
+{
+    cerr << "Control: the control socket is only supported on POSIX systems" << endl;
+    return false;
+}
+
+void ControlServer::stop()
+{
+    running_ = false;
+}
+
+void ControlServer::run()
+{
+}
+
+bool ControlServer::serve(Client &)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,73 @@
+// control_socket.h : runtime reconfiguration over a Unix-domain socket
+//
+// One command per line, one reply line per command ("ok ..." or "error ...").
+// The socket thread only queues commands; they run on the capture thread
+// between two frames via process(), so the handler can touch the camera and
+// the pipeline without any locking of its own. Up to MAX_CLIENTS clients can
+// stay connected at once, so an idle connection never locks out the GUI.
+//
+//   echo "bitrate 4096" | socat - UNIX-CONNECT:/tmp/camera_module.sock
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whitespace separated words of a command line.
+std::vector<std::string> split_command(const std::string &line);
+
+class ControlServer {
+public:
+    typedef std::function<std::string(const std::vector<std::string> &args)> Handler;
+
+    ControlServer();
+    ~ControlServer();
+
+    // Creates the socket at path, replacing a stale one left by a crash.
+    bool start(const std::string &path);
+    void stop();
+
+    // Runs every queued command through handler on the calling thread and
+    // hands the replies back to the socket thread. Cheap when nothing is queued.
+    void process(const Handler &handler);
+
+    // True when commands are waiting, lets the caller skip locking around process().
+    bool has_pending() const { return pending_.load(std::memory_order_acquire) != 0; }
+
+private:
+    struct Command {
+        std::vector<std::string> args;
+        std::string reply;
+        bool started;     // picked up by process(), can no longer be withdrawn
+        bool done;
+        bool cancelled;   // timed out before it started, process() skips it
+    };
+
+    struct Client {
+        int fd;
+        std::string pending;   // received, not yet a full line
+    };
+
+    void run();
+    // Reads what client has sent and replies to its complete lines. False once
+    // the client is gone or misbehaving and should be closed.
+    bool serve(Client &client);
+    std::string submit(const std::vector<std::string> &args);
+
+    std::string path_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<int> pending_;
+    int listen_fd_;
+
+    std::mutex mutex_;
+    std::condition_variable done_cv_;
+    std::deque<std::shared_ptr<Command>> queue_;
+};
@@ -0,0 +1,102 @@
+#include "frame_pool.h"
+#include "realtime.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+static const size_t PAGE_SIZE_BYTES = 4096;
+
+static unsigned char *aligned_alloc_pages(size_t size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return static_cast<unsigned char *>(_aligned_malloc(size, PAGE_SIZE_BYTES));
+#else
+    void *memory = nullptr;
+    if (posix_memalign(&memory, PAGE_SIZE_BYTES, size) != 0)
+        return nullptr;
+    return static_cast<unsigned char *>(memory);
+#endif
+}
+
+static void aligned_free_pages(unsigned char *memory)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+FramePool::FramePool(size_t frame_size, size_t count)
+    : frame_size_(frame_size),
+      slot_size_((frame_size + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES * PAGE_SIZE_BYTES),
+      memory_(aligned_alloc_pages(slot_size_ * count)),
+      slots_(memory_ ? count : 0)
+{
+    if (!memory_) {
+        cerr << "FramePool: failed to allocate " << count << " frames of " << frame_size << " bytes" << endl;
+        return;
+    }
+    free_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        slots_[i].pool = this;
+        slots_[i].data = memory_ + i * slot_size_;
+        free_.push_back(&slots_[i]);
+    }
+}
+
+FramePool::~FramePool()
+{
+    if (free_.size() != slots_.size()) {
+        // A buffer still references pool memory; leaking beats a use-after-free.
+        cerr << "FramePool: " << slots_.size() - free_.size() << " frames still in flight at shutdown" << endl;
+        return;
+    }
+    if (memory_)
+        aligned_free_pages(memory_);
+}
+
+GstBuffer *FramePool::acquire(unsigned char **data)
+{
+    Slot *slot;
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (free_.empty())
+            return nullptr;
+        slot = free_.back();
+        free_.pop_back();
+    }
+    *data = slot->data;
+    return gst_buffer_new_wrapped_full(static_cast<GstMemoryFlags>(0), slot->data, frame_size_,
+                                       0, frame_size_, slot, &FramePool::release);
+}
+
+void FramePool::release(gpointer user_data)
+{
+    Slot *slot = static_cast<Slot *>(user_data);
+    lock_guard<mutex> lock(slot->pool->mutex_);
+    slot->pool->free_.push_back(slot);
+}
+
+void FramePool::prefault()
+{
+    if (memory_)
+        memset(memory_, 0, slot_size_ * slots_.size());
+}
+
+bool FramePool::lock()
+{
+    return memory_ && lock_region(memory_, slot_size_ * slots_.size());
+}
+
+size_t FramePool::available()
+{
+    lock_guard<mutex> lock(mutex_);
+    return free_.size();
+}
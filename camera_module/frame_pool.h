@@ -0,0 +1,49 @@
+// frame_pool.h : preallocated frame memory handed to GStreamer without copies
+//
+// Frames are converted straight into pool memory and wrapped in a GstBuffer
+// whose release returns the frame to the pool, replacing the per-frame
+// gst_buffer_new_allocate + gst_buffer_fill. The whole pool is allocated,
+// page aligned and touched up front so the capture loop never page faults.
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <gst/gst.h>
+
+class FramePool {
+public:
+    FramePool(size_t frame_size, size_t count);
+    ~FramePool();
+
+    // Wraps a free frame in a GstBuffer, or returns nullptr when every frame is
+    // still in flight downstream. data receives the frame memory to fill.
+    GstBuffer *acquire(unsigned char **data);
+
+    // Write to every page so the memory is resident before capture starts.
+    void prefault();
+
+    // mlock just the pool, for when mlockall is not permitted.
+    bool lock();
+
+    size_t frame_size() const { return frame_size_; }
+    size_t available();
+
+private:
+    FramePool(const FramePool &);
+    FramePool &operator=(const FramePool &);
+
+    struct Slot {
+        FramePool *pool;
+        unsigned char *data;
+    };
+    static void release(gpointer user_data);
+
+    size_t frame_size_;
+    size_t slot_size_;
+    unsigned char *memory_;
+    std::vector<Slot> slots_;
+    std::vector<Slot *> free_;
+    std::mutex mutex_;   // acquire on the capture thread, release on streaming threads
+};
@@ -3,9 +3,19 @@
 #include <sstream>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
 #include "FlyCapture2.h"
 #include <gst/gst.h>
 #include <gst/app/gstappsrc.h>
+#include "batch_udp_sink.h"
+#include "bayer.h"
+#include "control_socket.h"
+#include "frame_pool.h"
+#include "metrics.h"
+#include "options.h"
+#include "realtime.h"
 #define DEBUG 0  // Will capture exactly 100 frames
 using namespace FlyCapture2;
 using namespace std;
@@ -42,124 +52,332 @@ static void PrintCameraInfo(CameraInfo *pCamInfo)
 
 static void PrintError(Error error) { error.PrintErrorTrace(); }
 
-GstElement *create_udp_lossless_pipeline(const string& host, int port) {
-    ostringstream pipeline_str;
-    pipeline_str << "appsrc name=mysrc format=time is-live=true "
-                 << "caps=video/x-raw,format=GRAY8,width=1280,height=1024,framerate=30/1 ! "
-                 << "videoconvert ! "
-                 << "x264enc tune=zerolatency speed-preset=ultrafast ! "
-                 << "rtph264pay config-interval=1 ! "
-                 << "udpsink host=" << host << " port=" << port;
-    
-    return gst_parse_launch(pipeline_str.str().c_str(), nullptr);
+struct StreamerMetrics {
+    Counter *captured;
+    Counter *converted;
+    Counter *pushed;
+    Counter *dropped;
+    Counter *capture_errors;
+    Counter *bytes_sent;
+    Gauge *queue_bytes;
+    Gauge *queue_frames;
+    Gauge *encoder_bitrate;
+    Gauge *temperature;
+    Gauge *time_to_first_frame;
+    Histogram *retrieve_time;
+    Histogram *convert_time;
+    Histogram *push_time;
+    Histogram *frame_time;
+};
+
+static StreamerMetrics register_metrics(MetricsRegistry &registry)
+{
+    const vector<double> stage_buckets = {0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.033, 0.05, 0.1, 0.25};
+    const string stage_help = "Time spent per frame in each capture loop stage";
+
+    StreamerMetrics m;
+    m.captured = &registry.counter("streamer_frames_captured_total", "Frames retrieved from the camera");
+    m.converted = &registry.counter("streamer_frames_converted_total", "Frames converted to MONO8 or demosaiced to I420");
+    m.pushed = &registry.counter("streamer_frames_pushed_total", "Frames pushed into the GStreamer pipeline");
+    m.dropped = &registry.counter("streamer_frames_dropped_total", "Frames lost between camera and pipeline");
+    m.capture_errors = &registry.counter("streamer_camera_errors_total", "Failed RetrieveBuffer calls");
+    m.bytes_sent = &registry.counter("streamer_rtp_bytes_total", "RTP payload bytes handed to the network sink");
+    m.queue_bytes = &registry.gauge("streamer_appsrc_queue_bytes", "Bytes queued in appsrc");
+    m.queue_frames = &registry.gauge("streamer_appsrc_queue_frames", "Frames queued in appsrc");
+    m.encoder_bitrate = &registry.gauge("streamer_encoder_bitrate_kbps", "Configured x264enc bitrate");
+    m.temperature = &registry.gauge("streamer_camera_temperature_celsius", "Camera temperature");
+    m.time_to_first_frame = &registry.gauge("streamer_time_to_first_frame_seconds",
+                                            "Process start until the first camera frame left the payloader");
+    m.retrieve_time = &registry.histogram("streamer_stage_seconds", stage_help, stage_buckets, "stage=\"retrieve\"");
+    m.convert_time = &registry.histogram("streamer_stage_seconds", stage_help, stage_buckets, "stage=\"convert\"");
+    m.push_time = &registry.histogram("streamer_stage_seconds", stage_help, stage_buckets, "stage=\"push\"");
+    m.frame_time = &registry.histogram("streamer_stage_seconds", stage_help, stage_buckets, "stage=\"frame\"");
+    return m;
 }
 
-int main(){
-    // FlyCapture basic stuff
-    PrintBuildInfo();
-    Error error;
+// Counts every byte leaving the payloader, buffers and buffer lists alike.
+static GstPadProbeReturn count_bytes_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Counter *bytes = static_cast<Counter *>(user_data);
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+        bytes->inc(gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info)));
+    else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+        bytes->inc(gst_buffer_list_calculate_size(GST_PAD_PROBE_INFO_BUFFER_LIST(info)));
+    return GST_PAD_PROBE_OK;
+}
 
-    // Gstreamer setup
-    int argc = 0;
-    char **argv = nullptr;
-    gst_init(&argc, &argv);
-    gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+// TEMPERATURE reports tenths of a Kelvin in valueA.
+static bool read_temperature(Camera &cam, double *celsius)
+{
+    Property prop;
+    prop.type = TEMPERATURE;
+    if (cam.GetProperty(&prop) != PGRERROR_OK || !prop.present)
+        return false;
+    *celsius = prop.valueA / 10.0 - 273.15;
+    return true;
+}
 
-    // Default host and port
-    string host = "127.0.0.1";
-    int port = 5000;
+// Samples the temperature once per second on its own thread, keeping the
+// register read (a bus round trip) out of the capture loop. cameraMutex is
+// held by the capture thread only while it reconfigures the camera.
+class TemperaturePoller {
+public:
+    TemperaturePoller(Camera &cam, std::mutex &cameraMutex, Gauge *gauge)
+        : cam_(cam), cameraMutex_(cameraMutex), gauge_(gauge), running_(false)
+    {
+    }
+    ~TemperaturePoller() { stop(); }
 
-    // Parse command line arguments for host and port
-    // Usage example: ./your_program 192.168.1.42 6000
-    if (argc > 1) {
-        host = argv[1];
+    void start()
+    {
+        running_ = true;
+        thread_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_) {
+                lock.unlock();
+                double celsius;
+                bool ok;
+                {
+                    std::lock_guard<std::mutex> camera(cameraMutex_);
+                    ok = read_temperature(cam_, &celsius);
+                }
+                if (ok) {
+                    gauge_->set(celsius);
+                }
+                lock.lock();
+                stop_cv_.wait_for(lock, std::chrono::seconds(1), [this]() { return !running_; });
+            }
+        });
     }
-    if (argc > 2) {
-        port = stoi(argv[2]);
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        stop_cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
     }
 
-    cout << "Using host: " << host << ", port: " << port << endl;
-    
-    // UDP streaming
-    GstElement *pipeline = create_udp_lossless_pipeline("127.0.0.1", 5000);
-    
-    if (!pipeline) {
-        cerr << "Failed to create pipeline" << endl;
-        return -1;
+private:
+    Camera &cam_;
+    std::mutex &cameraMutex_;
+    Gauge *gauge_;
+    std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool running_;
+    std::thread thread_;
+};
+
+static double seconds_between(std::chrono::steady_clock::time_point from,
+                               std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+// Ask the encoder for an IDR frame with SPS/PPS on the next buffer. Same event as
+// gst_video_event_new_downstream_force_key_unit, built by hand to avoid linking
+// gstreamer-video for one call.
+static void request_keyframe(GstElement *appsrc)
+{
+    GstStructure *s = gst_structure_new("GstForceKeyUnit",
+        "timestamp", G_TYPE_UINT64, GST_CLOCK_TIME_NONE,
+        "stream-time", G_TYPE_UINT64, GST_CLOCK_TIME_NONE,
+        "running-time", G_TYPE_UINT64, GST_CLOCK_TIME_NONE,
+        "all-headers", G_TYPE_BOOLEAN, TRUE,
+        "count", G_TYPE_UINT, 0,
+        NULL);
+    gst_element_send_event(appsrc, gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, s));
+}
+
+// Pre-roll bookkeeping shared with the payloader probe.
+struct Preroll {
+    GstClockTime first_real_pts;   // anything earlier is a warm-up frame
+    std::chrono::steady_clock::time_point process_start;
+    Gauge *time_to_first_frame;
+    std::mutex mutex;
+    std::condition_variable reached_cv;
+    bool reached;
+};
+
+// Drops warm-up frames at the payloader so they never reach the network, and
+// records when the first real frame gets there.
+static GstPadProbeReturn preroll_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Preroll *preroll = static_cast<Preroll *>(user_data);
+    GstBuffer *buffer = nullptr;
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        if (gst_buffer_list_length(list) > 0)
+            buffer = gst_buffer_list_get(list, 0);
+    } else {
+        buffer = GST_PAD_PROBE_INFO_BUFFER(info);
     }
 
-    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    if (buffer && GST_BUFFER_PTS_IS_VALID(buffer) && GST_BUFFER_PTS(buffer) < preroll->first_real_pts) {
+        std::lock_guard<std::mutex> lock(preroll->mutex);
+        preroll->reached = true;
+        preroll->reached_cv.notify_all();
+        return GST_PAD_PROBE_DROP;
+    }
 
-    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "mysrc");
+    double seconds = seconds_between(preroll->process_start, std::chrono::steady_clock::now());
+    preroll->time_to_first_frame->set(seconds);
+    cout << "Time to first frame: " << static_cast<int>(seconds * 1000) << " ms" << endl;
+    return GST_PAD_PROBE_REMOVE;
+}
+
+// Sensor region read out by the camera, the full 1280x1024 unless changed at runtime.
+struct Roi {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+static const Roi FULL_SENSOR = {0, 0, 1280, 1024};
+
+// What goes into appsrc for the selected colour mode.
+struct StreamFormat {
+    const char *gstFormat;
+    int width;
+    int height;
+    unsigned int frameSize;
+};
+
+static StreamFormat stream_format(ColorMode color, const Roi &roi)
+{
+    StreamFormat f;
+    f.gstFormat = color == COLOR_MONO ? "GRAY8" : "I420";
+    f.width = color == COLOR_BAYER_HALF ? roi.width / 2 : roi.width;
+    f.height = color == COLOR_BAYER_HALF ? roi.height / 2 : roi.height;
+    f.frameSize = color == COLOR_MONO ? f.width * f.height : i420_size(f.width, f.height);
+    return f;
+}
+
+static bool to_bayer_pattern(BayerTileFormat tile, BayerPattern *pattern)
+{
+    switch (tile) {
+    case RGGB: *pattern = BAYER_RGGB; return true;
+    case BGGR: *pattern = BAYER_BGGR; return true;
+    case GRBG: *pattern = BAYER_GRBG; return true;
+    case GBRG: *pattern = BAYER_GBRG; return true;
+    default: return false;
+    }
+}
+
+// Format7 mode 0 readout of roi. RAW8 keeps the Bayer mosaic untouched for the demosaic.
+static bool set_format7(Camera &cam, const Roi &roi, PixelFormat pixelFormat)
+{
+    Format7ImageSettings fmt7;
+    fmt7.mode = MODE_0;
+    fmt7.offsetX = roi.x;
+    fmt7.offsetY = roi.y;
+    fmt7.width = roi.width;
+    fmt7.height = roi.height;
+    fmt7.pixelFormat = pixelFormat;
+
+    bool valid;
+    Format7PacketInfo packetInfo;
+    Error error = cam.ValidateFormat7Settings(&fmt7, &valid, &packetInfo);
+    if (error != PGRERROR_OK) {
+        PrintError(error);
+        return false;
+    }
+    if (!valid) {
+        cout << "Format7 " << roi.width << "x" << roi.height << "+" << roi.x << "+" << roi.y
+             << " is not supported by this camera" << endl;
+        return false;
+    }
+    error = cam.SetFormat7Configuration(&fmt7, packetInfo.recommendedBytesPerPacket);
+    if (error != PGRERROR_OK) {
+        PrintError(error);
+        return false;
+    }
+    return true;
+}
+
+// Readout configuration as the camera has it, standard video mode or Format7
+struct CameraMode {
+    VideoMode videoMode;
+    FrameRate frameRate;
+    Format7ImageSettings format7;
+    unsigned int packetSize;
+};
+
+static bool save_camera_mode(Camera &cam, CameraMode *mode)
+{
+    Error error = cam.GetVideoModeAndFrameRate(&mode->videoMode, &mode->frameRate);
+    if (error == PGRERROR_OK && mode->videoMode == VIDEOMODE_FORMAT7) {
+        float percentage;
+        error = cam.GetFormat7Configuration(&mode->format7, &mode->packetSize, &percentage);
+    }
+    if (error != PGRERROR_OK) {
+        PrintError(error);
+        return false;
+    }
+    return true;
+}
+
+static bool restore_camera_mode(Camera &cam, const CameraMode &mode)
+{
+    Error error = mode.videoMode == VIDEOMODE_FORMAT7
+        ? cam.SetFormat7Configuration(&mode.format7, mode.packetSize)
+        : cam.SetVideoModeAndFrameRate(mode.videoMode, mode.frameRate);
+    if (error != PGRERROR_OK) {
+        PrintError(error);
+        return false;
+    }
+    return true;
+}
+
+// Bus enumeration, connect and configuration, run concurrently with pipeline set-up.
+static bool open_camera(Camera &cam, CameraInfo *camInfo, bool rawBayer)
+{
+    Error error;
 
-    // Set caps with the correct framerate
-    GstCaps *caps = gst_caps_new_simple("video/x-raw",
-        "format", G_TYPE_STRING, "GRAY8",
-        "width", G_TYPE_INT, 1280,
-        "height", G_TYPE_INT, 1024,
-        "framerate", GST_TYPE_FRACTION, 30, 1,
-        NULL);
-    gst_app_src_set_caps(GST_APP_SRC(appsrc), caps);
-    gst_caps_unref(caps);
-        
     // Get camera
     BusManager busMgr;
     unsigned int numCameras;
     error = busMgr.GetNumOfCameras(&numCameras);
     if (error != PGRERROR_OK){
         PrintError(error);
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
     cout << "Number of cameras detected: " << numCameras << endl;
     if (numCameras == 0) {
         cout << "No cameras detected!" << endl;
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
     PGRGuid guid;
     error = busMgr.GetCameraFromIndex(0, &guid);
     if (error != PGRERROR_OK){
         PrintError(error);
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
     // Connect to a camera
-    Camera cam;
     error = cam.Connect(&guid);
     if (error != PGRERROR_OK)
     {
         PrintError(error);
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
     // Get the camera information
-    CameraInfo camInfo;
-    error = cam.GetCameraInfo(&camInfo);
+    error = cam.GetCameraInfo(camInfo);
     if (error != PGRERROR_OK)
     {
         PrintError(error);
         cam.Disconnect();
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
-    PrintCameraInfo(&camInfo);
-
     // Get the camera configuration
     FC2Config config;
     error = cam.GetConfiguration(&config);
@@ -167,10 +385,7 @@ int main(){
     {
         PrintError(error);
         cam.Disconnect();
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
     // Set the number of driver buffers used to 10.
@@ -182,30 +397,458 @@ int main(){
     {
         PrintError(error);
         cam.Disconnect();
-        gst_element_set_state(pipeline, GST_STATE_NULL);
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        return -1;
+        return false;
     }
 
-    // Start capturing images
+    if (rawBayer) {
+        if (!camInfo->isColorCamera) {
+            cout << "Colour mode needs a colour camera" << endl;
+            cam.Disconnect();
+            return false;
+        }
+        if (!set_format7(cam, FULL_SENSOR, PIXEL_FORMAT_RAW8)) {
+            cam.Disconnect();
+            return false;
+        }
+    }
+
+    // Start capturing images, the sensor warms up while the pipeline pre-rolls
     error = cam.StartCapture();
     if (error != PGRERROR_OK)
     {
         PrintError(error);
         cam.Disconnect();
+        return false;
+    }
+    return true;
+}
+
+GstElement *create_udp_lossless_pipeline(const StreamerOptions &opts, const StreamFormat &format) {
+    ostringstream pipeline_str;
+    pipeline_str << "appsrc name=mysrc format=time is-live=true "
+                 << "caps=video/x-raw,format=" << format.gstFormat << ",width=" << format.width
+                 << ",height=" << format.height << ",framerate=30/1 ! ";
+    // I420 is what x264enc takes natively, only GRAY8 needs converting
+    if (format.gstFormat != string("I420")) {
+        pipeline_str << "videoconvert ! ";
+    }
+    pipeline_str << "x264enc name=encoder tune=zerolatency speed-preset=ultrafast ! "
+                 << "rtph264pay name=pay config-interval=1 ! "
+                 << opts.sink << " name=udpout host=" << opts.host << " port=" << opts.port;
+    if (opts.max_rate > 0) {
+        pipeline_str << " max-rate=" << opts.max_rate;
+    }
+
+    return gst_parse_launch(pipeline_str.str().c_str(), nullptr);
+}
+
+static void set_stream_caps(GstElement *appsrc, const StreamFormat &format, int fps)
+{
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+        "format", G_TYPE_STRING, format.gstFormat,
+        "width", G_TYPE_INT, format.width,
+        "height", G_TYPE_INT, format.height,
+        "framerate", GST_TYPE_FRACTION, fps, 1,
+        NULL);
+    gst_app_src_set_caps(GST_APP_SRC(appsrc), caps);
+    gst_caps_unref(caps);
+}
+
+// Absolute value in the property's own unit (ms, dB, fps), or "auto".
+static bool set_camera_property(Camera &cam, PropertyType type, const string &value)
+{
+    Property prop;
+    prop.type = type;
+    Error error = cam.GetProperty(&prop);
+    if (error != PGRERROR_OK || !prop.present) {
+        return false;
+    }
+    prop.onOff = true;
+    prop.autoManualMode = value == "auto";
+    if (!prop.autoManualMode) {
+        prop.absControl = true;
+        prop.absValue = stof(value);
+    }
+    error = cam.SetProperty(&prop);
+    if (error != PGRERROR_OK) {
+        PrintError(error);
+        return false;
+    }
+    return true;
+}
+
+// Live stream state. Only the capture loop touches it, control commands
+// included, so none of it needs locking.
+struct Stream {
+    Camera *cam;
+    CameraInfo *camInfo;
+    GstElement *appsrc;
+    GstElement *encoder;
+    GstElement *sink;
+    StreamerMetrics *metrics;
+    ColorMode color;
+    string host;
+    int port;
+    int fps;
+    GstClockTime duration;
+    GstClockTime timestamp;
+    Roi roi;
+    StreamFormat format;
+    bool paused;
+    std::chrono::steady_clock::time_point pausedAt;
+    bool captureStopped;   // StartCapture failed after a reconfiguration, the loop retries
+};
+
+// Moves the camera readout to roi. Capture is stopped for the switch only,
+// the connection and the pipeline stay up.
+static string change_roi(Stream &s, const Roi &roi)
+{
+    if (roi.x < 0 || roi.y < 0 || roi.x % 2 || roi.y % 2 ||
+        roi.width < 64 || roi.height < 64 || roi.width % 16 || roi.height % 4 ||
+        roi.x + roi.width > FULL_SENSOR.width || roi.y + roi.height > FULL_SENSOR.height) {
+        return "error roi needs even offsets, width a multiple of 16 and height of 4, inside 1280x1024";
+    }
+    // RAW8 for anything colour, the MONO8 conversion handles a mosaic as well
+    PixelFormat pixelFormat = s.color != COLOR_MONO || s.camInfo->isColorCamera ? PIXEL_FORMAT_RAW8
+                                                                               : PIXEL_FORMAT_MONO8;
+    CameraMode previous;
+    if (!save_camera_mode(*s.cam, &previous)) {
+        return "error could not read the camera mode";
+    }
+    s.cam->StopCapture();
+    bool applied = set_format7(*s.cam, roi, pixelFormat);
+    if (!applied) {
+        // Back to exactly what ran before, which may not have been Format7
+        restore_camera_mode(*s.cam, previous);
+    }
+    Error error = s.cam->StartCapture();
+    if (error != PGRERROR_OK) {
+        PrintError(error);
+        s.captureStopped = true;
+        if (applied) {
+            // The new readout is what the camera has now, keep the stream consistent with it
+            s.roi = roi;
+            s.format = stream_format(s.color, roi);
+            set_stream_caps(s.appsrc, s.format, s.fps);
+        }
+        return "error camera did not restart, retrying";
+    }
+    if (!applied) {
+        return "error camera rejected the roi";
+    }
+
+    // Pool frames are sized for the full sensor, so any roi fits them
+    s.roi = roi;
+    s.format = stream_format(s.color, roi);
+    set_stream_caps(s.appsrc, s.format, s.fps);
+    request_keyframe(s.appsrc);
+    return "ok";
+}
+
+static const char *CONTROL_HELP =
+    "ok commands: status | host ADDR | port N | bitrate KBPS | fps N | roi X Y W H | roi full | "
+    "shutter MS|auto | gain DB|auto | brightness PCT | pause | resume | keyframe";
+
+static string handle_command(Stream &s, const vector<string> &args)
+{
+    const string &cmd = args[0];
+    if (cmd == "help") {
+        return CONTROL_HELP;
+    }
+    if (cmd == "status" && args.size() == 1) {
+        guint bitrate = 0;
+        g_object_get(s.encoder, "bitrate", &bitrate, NULL);
+        ostringstream out;
+        out << "ok host=" << s.host << " port=" << s.port << " bitrate=" << bitrate << " fps=" << s.fps
+            << " roi=" << s.roi.width << "x" << s.roi.height << "+" << s.roi.x << "+" << s.roi.y
+            << " size=" << s.format.width << "x" << s.format.height
+            << " paused=" << (s.paused ? 1 : 0) << " capture=" << (s.captureStopped ? "stopped" : "running")
+            << " pushed=" << s.metrics->pushed->value();
+        return out.str();
+    }
+    if (cmd == "host" && args.size() == 2) {
+        // Both sinks swap their destination in place, the next packet goes to the new host
+        g_object_set(s.sink, "host", args[1].c_str(), NULL);
+        s.host = args[1];
+        request_keyframe(s.appsrc);
+        return "ok";
+    }
+    if (cmd == "port" && args.size() == 2) {
+        int port = stoi(args[1]);
+        if (port <= 0 || port > 65535) {
+            return "error port must be 1-65535";
+        }
+        g_object_set(s.sink, "port", port, NULL);
+        s.port = port;
+        request_keyframe(s.appsrc);
+        return "ok";
+    }
+    if (cmd == "bitrate" && args.size() == 2) {
+        // x264enc picks this up on the next frame, no re-initialisation
+        int kbps = stoi(args[1]);
+        if (kbps <= 0) {
+            return "error bitrate must be positive";
+        }
+        g_object_set(s.encoder, "bitrate", static_cast<guint>(kbps), NULL);
+        s.metrics->encoder_bitrate->set(kbps);
+        return "ok";
+    }
+    if (cmd == "fps" && args.size() == 2) {
+        int fps = stoi(args[1]);
+        if (fps < 1 || fps > 120) {
+            return "error fps must be 1-120";
+        }
+        if (!set_camera_property(*s.cam, FRAME_RATE, args[1])) {
+            return "error camera rejected the frame rate";
+        }
+        s.fps = fps;
+        s.duration = GST_SECOND / fps;
+        set_stream_caps(s.appsrc, s.format, fps);
+        return "ok";
+    }
+    if (cmd == "roi" && args.size() == 2 && args[1] == "full") {
+        return change_roi(s, FULL_SENSOR);
+    }
+    if (cmd == "roi" && args.size() == 5) {
+        Roi roi = {stoi(args[1]), stoi(args[2]), stoi(args[3]), stoi(args[4])};
+        return change_roi(s, roi);
+    }
+    if ((cmd == "shutter" || cmd == "gain" || cmd == "brightness") && args.size() == 2) {
+        PropertyType type = cmd == "shutter" ? SHUTTER : cmd == "gain" ? GAIN : BRIGHTNESS;
+        return set_camera_property(*s.cam, type, args[1]) ? "ok" : "error camera rejected " + cmd;
+    }
+    if (cmd == "pause" && args.size() == 1) {
+        if (!s.paused) {
+            s.paused = true;
+            s.pausedAt = std::chrono::steady_clock::now();
+        }
+        return "ok";
+    }
+    if (cmd == "resume" && args.size() == 1) {
+        if (s.paused) {
+            // Keep PTS in step with the pipeline clock across the gap
+            auto gap = std::chrono::steady_clock::now() - s.pausedAt;
+            s.timestamp += std::chrono::duration_cast<std::chrono::nanoseconds>(gap).count();
+            s.paused = false;
+            request_keyframe(s.appsrc);
+        }
+        return "ok";
+    }
+    if (cmd == "keyframe" && args.size() == 1) {
+        request_keyframe(s.appsrc);
+        return "ok";
+    }
+    return "error unknown command or wrong arguments, try help";
+}
+
+int main(int argc, char *argv[]){
+    const auto processStart = std::chrono::steady_clock::now();
+
+    // FlyCapture basic stuff
+    PrintBuildInfo();
+    Error error;
+
+    // Gstreamer setup, strips --gst-* options from argv
+    gst_init(&argc, &argv);
+    gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+
+    // Parse command line arguments for host and port
+    // Usage example: ./your_program 192.168.1.42 6000
+    StreamerOptions opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    const string &host = opts.host;
+    const int port = opts.port;
+
+    cout << "Using host: " << host << ", port: " << port << endl;
+
+    // Batched sender, statically registered so it needs no plugin path
+    if (opts.sink == "batchudpsink") {
+        if (!batch_udp_sink_register()) {
+            cerr << "batchudpsink is not available on this platform" << endl;
+            return -1;
+        }
+        cout << "Sink: batchudpsink";
+        if (opts.max_rate > 0) {
+            cout << ", paced at " << opts.max_rate << " kbit/s";
+        }
+        cout << endl;
+    }
+
+    // Metrics, served from their own thread
+    MetricsRegistry registry;
+    StreamerMetrics metrics = register_metrics(registry);
+    MetricsServer metricsServer(registry);
+    if (opts.metrics_port > 0) {
+        metricsServer.start(opts.metrics_port, opts.metrics_bind);
+    }
+
+    // Frame memory is converted into directly and wrapped, never copied
+    const StreamFormat format = stream_format(opts.color, FULL_SENSOR);
+    const unsigned int dataSize = format.frameSize;
+    if (opts.color != COLOR_MONO) {
+        cout << "Colour: " << format.width << "x" << format.height << " I420, "
+             << bayer_simd_name() << " demosaic" << endl;
+    }
+    FramePool framePool(dataSize, 8);
+    if (opts.lock_memory) {
+        if (lock_all_memory()) {
+            cout << "Realtime: all process memory locked" << endl;
+        } else if (framePool.lock()) {
+            cout << "Realtime: frame pool locked" << endl;
+        }
+    }
+    framePool.prefault();
+
+    // Camera bring-up on its own thread, overlapping with the pipeline below
+    Camera cam;
+    CameraInfo camInfo;
+    bool cameraReady = false;
+    double cameraSeconds = 0.0;
+    std::thread cameraThread([&]() {
+        auto cameraStart = std::chrono::steady_clock::now();
+        cameraReady = open_camera(cam, &camInfo, opts.color != COLOR_MONO);
+        cameraSeconds = seconds_between(cameraStart, std::chrono::steady_clock::now());
+    });
+
+    // Streaming and x264 threads are created from here on and inherit this affinity
+    if (!opts.encoder_cpus.empty() && pin_current_thread(opts.encoder_cpus)) {
+        cout << "Realtime: pipeline threads on CPU " << format_cpu_list(opts.encoder_cpus) << endl;
+    }
+
+    // UDP streaming
+    const auto pipelineStart = std::chrono::steady_clock::now();
+    GstElement *pipeline = create_udp_lossless_pipeline(opts, format);
+    
+    if (!pipeline) {
+        cerr << "Failed to create pipeline" << endl;
+        cameraThread.join();
+        if (cameraReady) {
+            cam.StopCapture();
+            cam.Disconnect();
+        }
+        return -1;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "mysrc");
+
+    static GstClockTime timestamp = 0;
+    const int fps = 30;
+    const GstClockTime duration = GST_SECOND / fps;
+
+    // Set caps with the correct framerate
+    set_stream_caps(appsrc, format, fps);
+
+    GstElement *encoder = gst_bin_get_by_name(GST_BIN(pipeline), "encoder");
+    GstElement *udpout = gst_bin_get_by_name(GST_BIN(pipeline), "udpout");
+    guint bitrate = 0;
+    g_object_get(encoder, "bitrate", &bitrate, NULL);
+    metrics.encoder_bitrate->set(bitrate);
+
+    // Pre-roll with a black frame: loads the remaining plugins and initialises
+    // x264 before the camera delivers. The first probe drops it at the payloader,
+    // so it is neither sent nor counted.
+    Preroll preroll;
+    preroll.first_real_pts = duration;
+    preroll.process_start = processStart;
+    preroll.time_to_first_frame = metrics.time_to_first_frame;
+    preroll.reached = false;
+
+    GstElement *pay = gst_bin_get_by_name(GST_BIN(pipeline), "pay");
+    GstPad *paySrc = gst_element_get_static_pad(pay, "src");
+    gst_pad_add_probe(paySrc, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                      preroll_probe, &preroll, NULL);
+    gst_pad_add_probe(paySrc, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                      count_bytes_probe, metrics.bytes_sent, NULL);
+    gst_object_unref(paySrc);
+    gst_object_unref(pay);
+
+    unsigned char *dummyData = nullptr;
+    GstBuffer *dummy = framePool.acquire(&dummyData);
+    if (opts.color == COLOR_MONO) {
+        memset(dummyData, 0, dataSize);
+    } else {
+        // Black in limited range I420: Y = 16, chroma at the midpoint
+        const unsigned int lumaSize = format.width * format.height;
+        memset(dummyData, 16, lumaSize);
+        memset(dummyData + lumaSize, 128, dataSize - lumaSize);
+    }
+    GST_BUFFER_PTS(dummy) = timestamp;
+    GST_BUFFER_DURATION(dummy) = duration;
+    timestamp += duration;
+    gst_app_src_push_buffer(GST_APP_SRC(appsrc), dummy);
+    {
+        std::unique_lock<std::mutex> lock(preroll.mutex);
+        if (!preroll.reached_cv.wait_for(lock, std::chrono::seconds(5), [&preroll] { return preroll.reached; })) {
+            cerr << "Pipeline did not pre-roll within 5 s, continuing" << endl;
+        }
+    }
+    double pipelineSeconds = seconds_between(pipelineStart, std::chrono::steady_clock::now());
+
+    // The warm-up IDR was dropped, make the first camera frame a keyframe
+    request_keyframe(appsrc);
+
+    cameraThread.join();
+    if (!cameraReady) {
         gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(udpout);
+        gst_object_unref(encoder);
         gst_object_unref(appsrc);
         gst_object_unref(pipeline);
         return -1;
     }
 
+    PrintCameraInfo(&camInfo);
+    cout << "Startup: camera ready in " << static_cast<int>(cameraSeconds * 1000) << " ms, "
+         << "pipeline pre-rolled in " << static_cast<int>(pipelineSeconds * 1000) << " ms" << endl;
+
     cout << "Starting capture..." << endl;
 
-    static GstClockTime timestamp = 0;
-    const int fps = 30;
-    const GstClockTime duration = GST_SECOND / fps;
-    const auto frame_delay = std::chrono::milliseconds(1000 / fps);
+    // Everything the control socket can change between frames
+    Stream stream;
+    stream.cam = &cam;
+    stream.camInfo = &camInfo;
+    stream.appsrc = appsrc;
+    stream.encoder = encoder;
+    stream.sink = udpout;
+    stream.metrics = &metrics;
+    stream.color = opts.color;
+    stream.host = host;
+    stream.port = port;
+    stream.fps = fps;
+    stream.duration = duration;
+    stream.timestamp = timestamp;
+    stream.roi = FULL_SENSOR;
+    stream.format = format;
+    stream.paused = false;
+    stream.captureStopped = false;
+
+    ControlServer controlServer;
+    if (!opts.control_socket.empty()) {
+        controlServer.start(opts.control_socket);
+    }
+    const ControlServer::Handler controlHandler = [&stream](const vector<string> &args) {
+        return handle_command(stream, args);
+    };
+
+    // Guards the camera against the temperature poller while commands reconfigure it
+    std::mutex cameraMutex;
+    TemperaturePoller temperaturePoller(cam, cameraMutex, metrics.temperature);
+    temperaturePoller.start();
+
+    // Capture thread gets its own core and real-time priority. Threads started
+    // from here on would inherit both, so helper threads are started above.
+    if (opts.capture_cpu >= 0 && pin_current_thread(vector<int>(1, opts.capture_cpu))) {
+        cout << "Realtime: capture thread on CPU " << opts.capture_cpu << endl;
+    }
+    if (opts.rt_priority > 0 && set_realtime_priority(opts.rt_priority)) {
+        cout << "Realtime: capture thread SCHED_FIFO priority " << opts.rt_priority << endl;
+    }
+
     int frameCount = 0;
     int max_frames = 100;
     while (true) {
@@ -217,44 +860,120 @@ int main(){
                 break;
             }
         #endif
+
+        // Pending reconfiguration lands between two frames
+        if (controlServer.has_pending()) {
+            std::lock_guard<std::mutex> lock(cameraMutex);
+            controlServer.process(controlHandler);
+        }
         
+        if (stream.captureStopped) {
+            // Keep trying to restart after a failed reconfiguration, commands still get through
+            if (cam.StartCapture() != PGRERROR_OK) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                continue;
+            }
+            cout << "Capture restarted" << endl;
+            stream.captureStopped = false;
+            request_keyframe(appsrc);
+        }
+
         // Acquire Image
         Image rawImage;
         error = cam.RetrieveBuffer(&rawImage);
+        auto retrieved = std::chrono::steady_clock::now();
+        if (error == PGRERROR_IMAGE_CONSISTENCY_ERROR) {
+            // Torn frame from dropped bus packets, skip it and keep streaming
+            metrics.capture_errors->inc();
+            metrics.dropped->inc();
+            continue;
+        }
         if (error != PGRERROR_OK) {
+            metrics.capture_errors->inc();
             PrintError(error);
             break;
         }
+        metrics.captured->inc();
+        metrics.retrieve_time->observe(seconds_between(start, retrieved));
+        if (stream.paused) {
+            // Keep draining the camera so resume starts from a fresh frame
+            continue;
+        }
 
-        // Convert to MONO8 (grayscale)
-        Image convertedImage;
-        error = rawImage.Convert(PIXEL_FORMAT_MONO8, &convertedImage);
-        if (error != PGRERROR_OK) {
-            PrintError(error);
-            break;
+        // Take a frame from the pool, if all are still queued downstream drop this one
+        unsigned char *data = nullptr;
+        GstBuffer *buffer = framePool.acquire(&data);
+        if (!buffer) {
+            metrics.dropped->inc();
+            continue;
         }
 
-        // Create GstBuffer
-        GstBuffer *buffer;
+        const StreamFormat &frameFormat = stream.format;
+        const Roi &roi = stream.roi;
+        if (opts.color == COLOR_MONO) {
+            // Convert to MONO8 (grayscale) straight into the pool frame
+            Image convertedImage(frameFormat.height, frameFormat.width, frameFormat.width,
+                                 data, frameFormat.frameSize, PIXEL_FORMAT_MONO8);
+            error = rawImage.Convert(PIXEL_FORMAT_MONO8, &convertedImage);
+            if (error != PGRERROR_OK) {
+                gst_buffer_unref(buffer);
+                metrics.dropped->inc();
+                PrintError(error);
+                break;
+            }
+            // The SDK reallocates when the target does not fit, copy back in that case
+            if (convertedImage.GetData() != data) {
+                memcpy(data, convertedImage.GetData(), frameFormat.frameSize);
+            }
+        } else {
+            // Demosaic the RAW8 mosaic straight into I420, no SDK Convert or videoconvert
+            BayerPattern pattern;
+            if (!to_bayer_pattern(rawImage.GetBayerTileFormat(), &pattern) ||
+                static_cast<int>(rawImage.GetCols()) != roi.width ||
+                static_cast<int>(rawImage.GetRows()) != roi.height) {
+                gst_buffer_unref(buffer);
+                metrics.dropped->inc();
+                cerr << "Unexpected raw frame " << rawImage.GetCols() << "x" << rawImage.GetRows()
+                     << ", Bayer tile " << rawImage.GetBayerTileFormat() << endl;
+                break;
+            }
+            if (opts.color == COLOR_BAYER_HALF) {
+                bayer_to_i420_half(rawImage.GetData(), roi.width, roi.height, rawImage.GetStride(), pattern, data);
+            } else {
+                bayer_to_i420(rawImage.GetData(), roi.width, roi.height, rawImage.GetStride(), pattern, data);
+            }
+        }
+        auto converted = std::chrono::steady_clock::now();
+        metrics.converted->inc();
+        metrics.convert_time->observe(seconds_between(retrieved, converted));
+
         GstFlowReturn ret;
-        unsigned int dataSize = 1280 * 1024;
-        unsigned char* data = convertedImage.GetData();
-        buffer = gst_buffer_new_allocate(NULL, dataSize, NULL);
-        gst_buffer_fill(buffer, 0, data, dataSize);
 
         // Set timestamps for proper streaming
-        GST_BUFFER_PTS(buffer) = timestamp;
-        GST_BUFFER_DURATION(buffer) = duration;
-        timestamp += duration;
+        // Pool frames are full size, only advertise what this frame holds
+        gst_buffer_set_size(buffer, frameFormat.frameSize);
+        GST_BUFFER_PTS(buffer) = stream.timestamp;
+        GST_BUFFER_DURATION(buffer) = stream.duration;
+        stream.timestamp += stream.duration;
 
         // Push buffer to pipeline
         ret = gst_app_src_push_buffer(GST_APP_SRC(appsrc), buffer);
         if (ret != GST_FLOW_OK) {
+            metrics.dropped->inc();
             cerr << "Error pushing buffer to GStreamer: " << ret << endl;
             break;
         }
+        auto pushed = std::chrono::steady_clock::now();
+        metrics.pushed->inc();
+        metrics.push_time->observe(seconds_between(converted, pushed));
+        metrics.frame_time->observe(seconds_between(start, pushed));
+
+        guint64 queued = gst_app_src_get_current_level_bytes(GST_APP_SRC(appsrc));
+        metrics.queue_bytes->set(static_cast<double>(queued));
+        metrics.queue_frames->set(static_cast<double>(queued) / frameFormat.frameSize);
 
         frameCount++;
+        const auto frame_delay = std::chrono::microseconds(1000000 / stream.fps);
         auto elapsed = std::chrono::steady_clock::now() - start;
         if (elapsed < frame_delay) {
             std::this_thread::sleep_for(frame_delay - elapsed);
@@ -262,15 +981,26 @@ int main(){
         if (frameCount % 30 == 0) {
             cout << "Frames processed: " << frameCount << endl;
         }
+        if (frameCount == fps && !opts.encoder_cpus.empty()) {
+            // x264 spawns its workers on the first frames, sweep up any that escaped
+            int moved = pin_other_threads(opts.encoder_cpus);
+            cout << "Realtime: " << moved << " other threads kept on CPU "
+                 << format_cpu_list(opts.encoder_cpus) << endl;
+        }
     }
 
     cout << "Stopping capture..." << endl;
+    temperaturePoller.stop();
+    controlServer.stop();
+    metricsServer.stop();
 
     // Send EOS to properly close the stream
     gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
 
     // Cleanup gst
     gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(udpout);
+    gst_object_unref(encoder);
     gst_object_unref(appsrc);
     gst_object_unref(pipeline);
 
@@ -0,0 +1,257 @@
+#include "metrics.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define close_socket close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+
+// ===================== Metric types =====================
+
+void Gauge::set(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits_.store(bits, memory_order_relaxed);
+}
+
+double Gauge::value() const
+{
+    uint64_t bits = bits_.load(memory_order_relaxed);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+Histogram::Histogram(const vector<double> &bounds)
+    : bounds_(bounds), buckets_(new atomic<uint64_t>[bounds.size() + 1]), count_(0), sum_ns_(0)
+{
+    for (size_t i = 0; i <= bounds_.size(); ++i)
+        buckets_[i].store(0);
+}
+
+void Histogram::observe(double seconds)
+{
+    size_t i = 0;
+    while (i < bounds_.size() && seconds > bounds_[i])
+        ++i;
+    buckets_[i].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    sum_ns_.fetch_add(static_cast<uint64_t>(seconds * 1e9), memory_order_relaxed);
+}
+
+// ===================== Registry =====================
+
+MetricsRegistry::Entry &MetricsRegistry::add(const string &name, const string &help, const string &labels)
+{
+    unique_ptr<Entry> entry(new Entry());
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+    entries_.push_back(move(entry));
+    return *entries_.back();
+}
+
+Counter &MetricsRegistry::counter(const string &name, const string &help, const string &labels)
+{
+    Entry &entry = add(name, help, labels);
+    entry.counter.reset(new Counter());
+    return *entry.counter;
+}
+
+Gauge &MetricsRegistry::gauge(const string &name, const string &help, const string &labels)
+{
+    Entry &entry = add(name, help, labels);
+    entry.gauge.reset(new Gauge());
+    return *entry.gauge;
+}
+
+Histogram &MetricsRegistry::histogram(const string &name, const string &help,
+                                      const vector<double> &bounds, const string &labels)
+{
+    Entry &entry = add(name, help, labels);
+    entry.histogram.reset(new Histogram(bounds));
+    return *entry.histogram;
+}
+
+static string with_labels(const string &labels, const string &extra = "")
+{
+    if (labels.empty() && extra.empty())
+        return "";
+    if (labels.empty())
+        return "{" + extra + "}";
+    if (extra.empty())
+        return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+string MetricsRegistry::render() const
+{
+    ostringstream out;
+    out.precision(9);
+    string previous;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry &e = *entries_[i];
+        if (e.name != previous) {
+            const char *type = e.counter ? "counter" : e.gauge ? "gauge" : "histogram";
+            out << "# HELP " << e.name << " " << e.help << "\n"
+                << "# TYPE " << e.name << " " << type << "\n";
+            previous = e.name;
+        }
+        if (e.counter) {
+            out << e.name << with_labels(e.labels) << " " << e.counter->value() << "\n";
+        } else if (e.gauge) {
+            out << e.name << with_labels(e.labels) << " " << e.gauge->value() << "\n";
+        } else {
+            const Histogram &h = *e.histogram;
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < h.bounds().size(); ++b) {
+                cumulative += h.bucket_count(b);
+                ostringstream le;
+                le << "le=\"" << h.bounds()[b] << "\"";
+                out << e.name << "_bucket" << with_labels(e.labels, le.str()) << " " << cumulative << "\n";
+            }
+            cumulative += h.bucket_count(h.bounds().size());
+            out << e.name << "_bucket" << with_labels(e.labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+            out << e.name << "_sum" << with_labels(e.labels) << " " << h.sum() << "\n";
+            out << e.name << "_count" << with_labels(e.labels) << " " << h.count() << "\n";
+        }
+    }
+    return out.str();
+}
+
+// ===================== HTTP server =====================
+
+MetricsServer::MetricsServer(const MetricsRegistry &registry)
+    : registry_(registry), running_(false), listen_fd_(static_cast<intptr_t>(INVALID_SOCKET))
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(int port, const string &bind_address)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        cerr << "Metrics: WSAStartup failed" << endl;
+        return false;
+    }
+#endif
+    socket_t fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == INVALID_SOCKET) {
+        cerr << "Metrics: failed to create socket" << endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<unsigned short>(port));
+    if (inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1) {
+        cerr << "Metrics: invalid bind address " << bind_address << endl;
+        close_socket(fd);
+        return false;
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        cerr << "Metrics: failed to listen on " << bind_address << ":" << port << endl;
+        close_socket(fd);
+        return false;
+    }
+
+    listen_fd_ = static_cast<intptr_t>(fd);
+    running_ = true;
+    thread_ = thread(&MetricsServer::run, this);
+    cout << "Metrics available at http://" << bind_address << ":" << port << "/metrics" << endl;
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (!running_.exchange(false))
+        return;
+    if (thread_.joinable())
+        thread_.join();
+    close_socket(static_cast<socket_t>(listen_fd_));
+    listen_fd_ = static_cast<intptr_t>(INVALID_SOCKET);
+}
+
+void MetricsServer::run()
+{
+    socket_t listen_fd = static_cast<socket_t>(listen_fd_);
+    while (running_) {
+        // Wake up regularly so stop() does not need to unblock accept().
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listen_fd, &readable);
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 200000;
+        if (select(static_cast<int>(listen_fd + 1), &readable, nullptr, nullptr, &timeout) <= 0)
+            continue;
+
+        socket_t client = accept(listen_fd, nullptr, nullptr);
+        if (client == INVALID_SOCKET)
+            continue;
+
+#if defined(_WIN32) || defined(_WIN64)
+        DWORD recv_timeout = 1000;
+#else
+        timeval recv_timeout;
+        recv_timeout.tv_sec = 1;
+        recv_timeout.tv_usec = 0;
+#endif
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&recv_timeout),
+                   sizeof(recv_timeout));
+
+        char request[1024];
+        int received = recv(client, request, sizeof(request) - 1, 0);
+        string response;
+        if (received > 0) {
+            request[received] = '\0';
+            if (strncmp(request, "GET /metrics", 12) == 0) {
+                string body = registry_.render();
+                ostringstream header;
+                header << "HTTP/1.0 200 OK\r\n"
+                       << "Content-Type: text/plain; version=0.0.4\r\n"
+                       << "Content-Length: " << body.size() << "\r\n\r\n";
+                response = header.str() + body;
+            } else {
+                response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+            }
+        }
+
+        size_t sent = 0;
+        while (sent < response.size()) {
+            int n = send(client, response.data() + sent, static_cast<int>(response.size() - sent), MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            sent += static_cast<size_t>(n);
+        }
+        close_socket(client);
+    }
+}
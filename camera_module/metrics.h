@@ -0,0 +1,98 @@
+// metrics.h : Prometheus-style counters, gauges and histograms
+//
+// Updates are single relaxed atomic operations so they can sit in the capture
+// loop. MetricsServer renders the registry on its own thread, it never takes a
+// lock the hot path also takes.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+class Counter {
+public:
+    Counter() : value_(0) {}
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_;
+};
+
+class Gauge {
+public:
+    Gauge() : bits_(0) {}
+    void set(double value);
+    double value() const;
+
+private:
+    std::atomic<uint64_t> bits_;   // double stored bit for bit
+};
+
+class Histogram {
+public:
+    // bounds are the upper bucket edges in seconds, ascending; +Inf is implicit.
+    explicit Histogram(const std::vector<double> &bounds);
+    void observe(double seconds);
+
+    const std::vector<double> &bounds() const { return bounds_; }
+    uint64_t bucket_count(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_ns_.load(std::memory_order_relaxed) / 1e9; }
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;   // non-cumulative
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_ns_;
+};
+
+// Owns all metrics. Register everything before MetricsServer::start(), the
+// registry itself is not modified afterwards. Metrics sharing a name (with
+// different labels) must be registered one after another.
+class MetricsRegistry {
+public:
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    Histogram &histogram(const std::string &name, const std::string &help,
+                         const std::vector<double> &bounds, const std::string &labels = "");
+
+    // Prometheus text exposition format 0.0.4
+    std::string render() const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::string help;
+        std::string labels;   // e.g. stage="retrieve"
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+    Entry &add(const std::string &name, const std::string &help, const std::string &labels);
+
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+// Minimal HTTP/1.0 server answering GET /metrics from its own thread.
+class MetricsServer {
+public:
+    explicit MetricsServer(const MetricsRegistry &registry);
+    ~MetricsServer();
+
+    // bind_address is an IPv4 address, "0.0.0.0" for every interface
+    bool start(int port, const std::string &bind_address);
+    void stop();
+
+private:
+    void run();
+
+    const MetricsRegistry &registry_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    intptr_t listen_fd_;
+};
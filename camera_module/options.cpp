@@ -0,0 +1,116 @@
+#include "options.h"
+#include "realtime.h"
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+void print_usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [options] [host] [port]" << endl
+         << "  host                  receiver address (default 127.0.0.1)" << endl
+         << "  port                  receiver UDP port (default 5000)" << endl
+         << "  --metrics-port N      Prometheus endpoint port, 0 = off (default 9110)" << endl
+         << "  --metrics-bind ADDR   metrics listen address, 0.0.0.0 = all (default 127.0.0.1)" << endl
+         << "  --color MODE          mono, bayer or bayer-half (default mono)" << endl
+         << "  --control-socket PATH Unix socket accepting runtime commands (default off)" << endl
+         << "  --sink NAME           udpsink or batchudpsink (default udpsink)" << endl
+         << "  --max-rate KBPS       batchudpsink pacing rate, 0 = off (default 0)" << endl
+         << "  --capture-cpu N       pin the capture thread to CPU N" << endl
+         << "  --encoder-cpus LIST   pin GStreamer/x264 threads, e.g. 0-2 or 1,2" << endl
+         << "  --rt-priority N       SCHED_FIFO priority 1-99 for the capture thread" << endl
+         << "  --mlock               lock all memory and pre-fault the frame pool" << endl
+         << "  --help                show this message" << endl;
+}
+
+bool parse_options(int argc, char *argv[], StreamerOptions &opts)
+{
+    vector<string> positional;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                return false;
+            } else if (arg == "--mlock") {
+                opts.lock_memory = true;
+            } else if (arg.compare(0, 2, "--") == 0) {
+                if (i + 1 >= argc) {
+                    cerr << "Missing value for " << arg << endl;
+                    return false;
+                }
+                string value = argv[++i];
+                if (arg == "--metrics-port") {
+                    opts.metrics_port = stoi(value);
+                    if (opts.metrics_port < 0 || opts.metrics_port > 65535) {
+                        cerr << "--metrics-port must be between 0 and 65535" << endl;
+                        return false;
+                    }
+                } else if (arg == "--metrics-bind") {
+                    opts.metrics_bind = value;
+                } else if (arg == "--color") {
+                    if (value == "mono") {
+                        opts.color = COLOR_MONO;
+                    } else if (value == "bayer") {
+                        opts.color = COLOR_BAYER;
+                    } else if (value == "bayer-half") {
+                        opts.color = COLOR_BAYER_HALF;
+                    } else {
+                        cerr << "--color must be mono, bayer or bayer-half" << endl;
+                        return false;
+                    }
+                } else if (arg == "--control-socket") {
+                    opts.control_socket = value;
+                } else if (arg == "--sink") {
+                    if (value != "udpsink" && value != "batchudpsink") {
+                        cerr << "--sink must be udpsink or batchudpsink" << endl;
+                        return false;
+                    }
+                    opts.sink = value;
+                } else if (arg == "--max-rate") {
+                    opts.max_rate = stoi(value);
+                    if (opts.max_rate < 0) {
+                        cerr << "--max-rate must not be negative" << endl;
+                        return false;
+                    }
+                } else if (arg == "--capture-cpu") {
+                    opts.capture_cpu = stoi(value);
+                } else if (arg == "--encoder-cpus") {
+                    if (!parse_cpu_list(value, opts.encoder_cpus))
+                        return false;
+                } else if (arg == "--rt-priority") {
+                    opts.rt_priority = stoi(value);
+                    if (opts.rt_priority < 1 || opts.rt_priority > 99) {
+                        cerr << "--rt-priority must be between 1 and 99" << endl;
+                        return false;
+                    }
+                } else {
+                    cerr << "Unknown option: " << arg << endl;
+                    return false;
+                }
+            } else {
+                positional.push_back(arg);
+            }
+        }
+        if (positional.size() > 2) {
+            cerr << "Too many arguments" << endl;
+            return false;
+        }
+        if (positional.size() > 0)
+            opts.host = positional[0];
+        if (positional.size() > 1)
+            opts.port = stoi(positional[1]);
+        if (opts.port < 1 || opts.port > 65535) {
+            cerr << "port must be between 1 and 65535" << endl;
+            return false;
+        }
+        if (opts.max_rate > 0 && opts.sink != "batchudpsink") {
+            cerr << "--max-rate needs --sink batchudpsink" << endl;
+            return false;
+        }
+    } catch (const logic_error &) {
+        cerr << "Invalid numeric argument" << endl;
+        return false;
+    }
+    return true;
+}
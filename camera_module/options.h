@@ -0,0 +1,36 @@
+// options.h : command line options for Main
+//
+// Usage: ./Main [options] [host] [port]
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum ColorMode {
+    COLOR_MONO,         // SDK conversion to GRAY8, as before
+    COLOR_BAYER,        // RAW8 demosaiced straight to I420
+    COLOR_BAYER_HALF    // RAW8 binned 2x2 to half-resolution I420
+};
+
+struct StreamerOptions {
+    std::string host = "127.0.0.1";
+    int port = 5000;
+    int metrics_port = 9110;   // 0 disables the metrics endpoint
+    std::string metrics_bind = "127.0.0.1";   // unauthenticated, local only unless asked
+    ColorMode color = COLOR_MONO;
+    std::string control_socket;   // Unix socket path for runtime changes, empty = off
+    std::string sink = "udpsink";  // udpsink or batchudpsink
+    int max_rate = 0;              // batchudpsink pacing in kbit/s, 0 = off
+
+    // Real-time tuning, all off by default
+    int capture_cpu = -1;             // core for the capture thread
+    std::vector<int> encoder_cpus;    // cores for GStreamer/x264 threads
+    int rt_priority = 0;              // SCHED_FIFO priority for capture, 1-99, 0 = off
+    bool lock_memory = false;         // mlockall and pre-fault the frame pool
+};
+
+void print_usage(const char *prog);
+
+// Parses argv after gst_init() has removed the GStreamer options.
+bool parse_options(int argc, char *argv[], StreamerOptions &opts);
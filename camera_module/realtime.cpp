@@ -0,0 +1,172 @@
+#include "realtime.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool parse_cpu_list(const string &text, vector<int> &cpus)
+{
+    cpus.clear();
+    istringstream items(text);
+    string item;
+    while (getline(items, item, ',')) {
+        if (item.empty())
+            continue;
+        char *end = nullptr;
+        long first = strtol(item.c_str(), &end, 10);
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (*end != '\0' || first < 0 || last < first) {
+            cerr << "Invalid CPU list: " << text << endl;
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(static_cast<int>(cpu));
+    }
+    return true;
+}
+
+string format_cpu_list(const vector<int> &cpus)
+{
+    ostringstream out;
+    for (size_t i = 0; i < cpus.size(); ++i)
+        out << (i ? "," : "") << cpus[i];
+    return out.str();
+}
+
+#if defined(__linux__)
+
+static bool make_cpu_set(const vector<int> &cpus, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (cpus[i] >= online) {
+            cerr << "Realtime: CPU " << cpus[i] << " not available (" << online << " online)" << endl;
+            return false;
+        }
+        CPU_SET(cpus[i], set);
+    }
+    return true;
+}
+
+bool pin_current_thread(const vector<int> &cpus)
+{
+    cpu_set_t set;
+    if (!make_cpu_set(cpus, &set))
+        return false;
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        cerr << "Realtime: failed to pin thread to CPU " << format_cpu_list(cpus) << ": " << strerror(err) << endl;
+        return false;
+    }
+    return true;
+}
+
+int pin_other_threads(const vector<int> &cpus)
+{
+    cpu_set_t set;
+    if (!make_cpu_set(cpus, &set))
+        return 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir)
+        return 0;
+    const pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+    int pinned = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        pid_t tid = static_cast<pid_t>(atoi(entry->d_name));
+        if (tid <= 0 || tid == self)
+            continue;
+        if (sched_setaffinity(tid, sizeof(set), &set) == 0)
+            pinned++;
+    }
+    closedir(dir);
+    return pinned;
+}
+
+bool set_realtime_priority(int priority)
+{
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err == 0)
+        return true;
+
+    cerr << "Realtime: SCHED_FIFO " << priority << " refused (" << strerror(err)
+         << "), needs CAP_SYS_NICE or an rtprio limit" << endl;
+    // Fallback: best effort boost within SCHED_OTHER. Raising priority needs
+    // the same CAP_SYS_NICE, or an RLIMIT_NICE allowing -10.
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), -10) == 0) {
+        cerr << "Realtime: using nice -10 for the capture thread instead" << endl;
+    } else {
+        cerr << "Realtime: nice -10 refused too (" << strerror(errno)
+             << "), capture runs at normal priority" << endl;
+    }
+    return false;
+}
+
+bool lock_all_memory()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        return true;
+    cerr << "Realtime: mlockall failed (" << strerror(errno)
+         << "), needs CAP_IPC_LOCK or a larger memlock limit" << endl;
+    return false;
+}
+
+bool lock_region(void *address, size_t size)
+{
+    if (mlock(address, size) == 0)
+        return true;
+    cerr << "Realtime: mlock of " << size / 1024 << " kB failed (" << strerror(errno) << ")" << endl;
+    return false;
+}
+
+#else
+
+bool pin_current_thread(const vector<int> &)
+{
+    cerr << "Realtime: CPU pinning is only supported on Linux" << endl;
+    return false;
+}
+
+int pin_other_threads(const vector<int> &)
+{
+    return 0;
+}
+
+bool set_realtime_priority(int)
+{
+    cerr << "Realtime: SCHED_FIFO is only supported on Linux" << endl;
+    return false;
+}
+
+bool lock_all_memory()
+{
+    cerr << "Realtime: memory locking is only supported on Linux" << endl;
+    return false;
+}
+
+bool lock_region(void *, size_t)
+{
+    return false;
+}
+
+#endif
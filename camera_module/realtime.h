@@ -0,0 +1,32 @@
+// realtime.h : CPU pinning, real-time priority and memory locking
+//
+// Every call logs what it applied and returns false instead of aborting when
+// the platform or missing privileges (CAP_SYS_NICE, CAP_IPC_LOCK) get in the
+// way, so Main still streams as an ordinary process.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// "3", "1,2" or "1-3" -> CPU indices. Empty text gives an empty list.
+bool parse_cpu_list(const std::string &text, std::vector<int> &cpus);
+
+std::string format_cpu_list(const std::vector<int> &cpus);
+
+// Restrict the calling thread to cpus. Threads it creates afterwards inherit this.
+bool pin_current_thread(const std::vector<int> &cpus);
+
+// Restrict every other thread of the process to cpus (Linux only).
+// Used to move GStreamer and x264 worker threads off the capture core.
+int pin_other_threads(const std::vector<int> &cpus);
+
+// SCHED_FIFO for the calling thread, falling back to a negative nice value.
+bool set_realtime_priority(int priority);
+
+// mlockall(MCL_CURRENT | MCL_FUTURE)
+bool lock_all_memory();
+
+// mlock a single region, used when mlockall is not permitted.
+bool lock_region(void *address, size_t size);
@@ -0,0 +1,303 @@
+#include "udp_batch.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+using namespace std;
+
+// Kernel limits for one GSO message: 64 segments, one IP datagram of payload
+static const size_t MAX_GSO_SEGMENTS = 64;
+static const size_t MAX_GSO_BYTES = 65507;
+static const size_t MAX_DATAGRAM = 65507;
+static const unsigned int MAX_MESSAGES = 1024;   // UIO_MAXIOV, sendmmsg's vlen cap
+
+UdpBatchSender::UdpBatchSender()
+    : fd_(-1), family_(0), gso_wanted_(true), gso_(false), max_rate_(0), burst_(32), last_errno_(0),
+      interrupted_(false)
+{
+}
+
+UdpBatchSender::~UdpBatchSender()
+{
+    close();
+}
+
+string UdpBatchSender::error_text() const
+{
+    return last_errno_ ? strerror(last_errno_) : "";
+}
+
+#ifdef __linux__
+
+bool UdpBatchSender::open(const string &host, int port, string *error)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    struct addrinfo *result = nullptr;
+    int rc = getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &result);
+    if (rc != 0) {
+        if (error) *error = "cannot resolve " + host + ": " + gai_strerror(rc);
+        return false;
+    }
+
+    if (fd_ < 0 || family_ != result->ai_family) {
+        close();
+        fd_ = socket(result->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) {
+            if (error) *error = string("socket: ") + strerror(errno);
+            freeaddrinfo(result);
+            return false;
+        }
+        family_ = result->ai_family;
+
+        // A 1280x1024 I-frame is a few hundred datagrams, give the batch room
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        apply_pacing_rate();
+    }
+    dest_.assign(reinterpret_cast<unsigned char *>(result->ai_addr),
+                 reinterpret_cast<unsigned char *>(result->ai_addr) + result->ai_addrlen);
+    freeaddrinfo(result);
+
+    // Kernels without UDP GSO reject the option altogether
+    int segment = 0;
+    socklen_t length = sizeof(segment);
+    gso_ = gso_wanted_ && getsockopt(fd_, SOL_UDP, UDP_SEGMENT, &segment, &length) == 0;
+    return true;
+}
+
+void UdpBatchSender::close()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    family_ = 0;
+}
+
+void UdpBatchSender::apply_pacing_rate()
+{
+    if (fd_ < 0)
+        return;
+    // bytes/s, ~0 removes the limit
+    unsigned int rate = max_rate_ ? static_cast<unsigned int>(min<uint64_t>(max_rate_ / 8, ~0u - 1)) : ~0u;
+    setsockopt(fd_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate));
+}
+
+namespace {
+struct GsoControl {
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    };
+};
+}
+
+bool UdpBatchSender::send_range(size_t begin, size_t end, size_t offset)
+{
+    // One message per GSO run (or per datagram without GSO)
+    vector<struct mmsghdr> messages;
+    vector<struct iovec> iovs;
+    vector<GsoControl> controls;
+    vector<size_t> firsts;
+    messages.reserve(end - begin);
+    iovs.reserve(end - begin);
+    controls.reserve(end - begin);
+
+    size_t i = begin;
+    while (i < end) {
+        const size_t segment = sizes_[i];
+        size_t count = 1;
+        size_t bytes = segment;
+        if (gso_) {
+            const size_t limit = min(MAX_GSO_SEGMENTS, MAX_GSO_BYTES / segment);
+            while (i + count < end && count < limit && sizes_[i + count] == segment) {
+                bytes += segment;
+                ++count;
+            }
+            // The last segment of a GSO message may be shorter, like a frame's final packet
+            if (i + count < end && count < limit && sizes_[i + count] < segment) {
+                bytes += sizes_[i + count];
+                ++count;
+            }
+        }
+
+        struct iovec iov;
+        iov.iov_base = &data_[offset];
+        iov.iov_len = bytes;
+        iovs.push_back(iov);
+
+        struct mmsghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_hdr.msg_name = &dest_[0];
+        message.msg_hdr.msg_namelen = static_cast<socklen_t>(dest_.size());
+        message.msg_hdr.msg_iov = &iovs.back();
+        message.msg_hdr.msg_iovlen = 1;
+        if (count > 1) {
+            controls.push_back(GsoControl());
+            memset(&controls.back(), 0, sizeof(GsoControl));
+            message.msg_hdr.msg_control = controls.back().buf;
+            message.msg_hdr.msg_controllen = sizeof(controls.back().buf);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message.msg_hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t size = static_cast<uint16_t>(segment);
+            memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+        }
+        messages.push_back(message);
+        firsts.push_back(i);
+
+        offset += bytes;
+        i += count;
+    }
+    firsts.push_back(end);
+
+    size_t sent = 0;
+    while (sent < messages.size()) {
+        unsigned int count = static_cast<unsigned int>(min<size_t>(messages.size() - sent, MAX_MESSAGES));
+        int rc = sendmmsg(fd_, &messages[sent], count, 0);
+        stats_.syscalls++;
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            // EIO: no checksum offload on the route, EINVAL: segment above the MTU
+            if (messages[sent].msg_hdr.msg_control &&
+                (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP || errno == ENOPROTOOPT)) {
+                gso_ = false;
+                const size_t resume = static_cast<unsigned char *>(iovs[sent].iov_base) - &data_[0];
+                return send_range(firsts[sent], end, resume);
+            }
+            last_errno_ = errno;
+            stats_.dropped += end - firsts[sent];
+            return false;
+        }
+        for (int m = 0; m < rc; ++m) {
+            stats_.packets += firsts[sent + m + 1] - firsts[sent + m];
+            stats_.bytes += messages[sent + m].msg_len;
+        }
+        sent += rc;
+    }
+    return true;
+}
+
+#else
+
+bool UdpBatchSender::open(const string &, int, string *error)
+{
+    if (error) *error = "batched UDP sending needs Linux";
+    return false;
+}
+
+void UdpBatchSender::close()
+{
+}
+
+void UdpBatchSender::apply_pacing_rate()
+{
+}
+
+bool UdpBatchSender::send_range(size_t begin, size_t end, size_t)
+{
+    stats_.dropped += end - begin;
+    return false;
+}
+
+#endif
+
+void UdpBatchSender::set_gso(bool enabled)
+{
+    gso_wanted_ = enabled;
+    if (!enabled)
+        gso_ = false;
+}
+
+void UdpBatchSender::set_max_rate(uint64_t bits_per_second, int burst)
+{
+    max_rate_ = bits_per_second;
+    burst_ = max(burst, 1);
+    apply_pacing_rate();
+}
+
+void UdpBatchSender::add(const unsigned char *data, size_t size)
+{
+    if (size == 0 || size > MAX_DATAGRAM) {
+        stats_.dropped++;
+        return;
+    }
+    data_.insert(data_.end(), data, data + size);
+    sizes_.push_back(size);
+}
+
+bool UdpBatchSender::flush()
+{
+    bool ok = true;
+    if (fd_ < 0) {
+        stats_.dropped += sizes_.size();
+        ok = sizes_.empty();
+    }
+
+    size_t begin = 0;
+    size_t offset = 0;
+    while (ok && begin < sizes_.size()) {
+        size_t end = sizes_.size();
+        if (max_rate_ > 0) {
+            end = min(end, begin + static_cast<size_t>(burst_));
+            if (!wait_for_next_send())
+                break;
+        }
+        size_t bytes = 0;
+        for (size_t i = begin; i < end; ++i)
+            bytes += sizes_[i];
+        ok = send_range(begin, end, offset);
+        offset += bytes;
+        if (max_rate_ > 0) {
+            // The next group may leave once this one has drained at max_rate_
+            const chrono::nanoseconds drain(static_cast<int64_t>(bytes * 8 * 1000000000ull / max_rate_));
+            next_send_ = max(next_send_, chrono::steady_clock::now()) + drain;
+        }
+        begin = end;
+    }
+
+    clear();
+    return ok;
+}
+
+void UdpBatchSender::clear()
+{
+    data_.clear();
+    sizes_.clear();
+}
+
+void UdpBatchSender::interrupt(bool interrupted)
+{
+    {
+        lock_guard<mutex> lock(wait_mutex_);
+        interrupted_ = interrupted;
+    }
+    wait_.notify_all();
+}
+
+bool UdpBatchSender::wait_for_next_send()
+{
+    unique_lock<mutex> lock(wait_mutex_);
+    return !wait_.wait_until(lock, next_send_, [this] { return interrupted_; });
+}
@@ -0,0 +1,89 @@
+// udp_batch.h : sends a batch of UDP datagrams in as few syscalls as possible
+//
+// Datagrams are collected with add() and sent by flush() in one sendmmsg call.
+// With UDP GSO (Linux 4.18+) each run of equal-sized datagrams is handed to
+// the kernel as a single message and only split into datagrams below the UDP
+// layer. When the kernel or the route rejects GSO, sending falls back to one
+// datagram per message. An optional maximum rate spreads a batch over time
+// instead of bursting it into the NIC at once.
+//
+// Linux only; elsewhere open() fails.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct UdpBatchStats {
+    uint64_t packets = 0;    // datagrams handed to the kernel
+    uint64_t bytes = 0;
+    uint64_t syscalls = 0;   // sendmmsg calls
+    uint64_t dropped = 0;    // datagrams lost to send errors
+};
+
+class UdpBatchSender {
+public:
+    UdpBatchSender();
+    ~UdpBatchSender();
+
+    // Resolves host and opens a socket for its address family. Can be called
+    // again to change the destination, pending datagrams are kept.
+    bool open(const std::string &host, int port, std::string *error);
+    void close();
+
+    void set_gso(bool enabled);
+
+    // bits_per_second 0 sends a batch at once, otherwise it goes out in
+    // groups of burst datagrams spaced to stay under the rate. The rate is
+    // also set as SO_MAX_PACING_RATE, which the fq qdisc enforces per packet.
+    void set_max_rate(uint64_t bits_per_second, int burst);
+
+    // Copies one datagram into the batch.
+    void add(const unsigned char *data, size_t size);
+    size_t pending() const { return sizes_.size(); }
+
+    // Sends and clears the batch. On a send error the rest of the batch is
+    // dropped and false returned, error_text() says why.
+    bool flush();
+
+    // Drops the batch without sending it.
+    void clear();
+
+    // Any thread. While set, a paced flush() stops waiting and drops the rest
+    // of its batch, so a flushing or stopping pipeline isn't held up.
+    void interrupt(bool interrupted);
+
+    bool gso_active() const { return gso_; }
+    std::string error_text() const;
+    const UdpBatchStats &stats() const { return stats_; }
+
+private:
+    // Datagrams [begin, end), the first one starting at data_[offset]
+    bool send_range(size_t begin, size_t end, size_t offset);
+    void apply_pacing_rate();
+    bool wait_for_next_send();   // false when interrupted
+
+    int fd_;
+    int family_;
+    std::vector<unsigned char> dest_;   // sockaddr of the destination
+    bool gso_wanted_;
+    bool gso_;
+    uint64_t max_rate_;
+    int burst_;
+    std::chrono::steady_clock::time_point next_send_;
+    int last_errno_;
+
+    std::mutex wait_mutex_;
+    std::condition_variable wait_;
+    bool interrupted_;   // guarded by wait_mutex_
+
+    // Datagrams back to back, so runs of them can be sent as one GSO buffer
+    std::vector<unsigned char> data_;
+    std::vector<size_t> sizes_;
+    UdpBatchStats stats_;
+};
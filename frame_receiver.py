@@ -1,5 +1,6 @@
 from PySide6.QtCore import QObject, Signal, QTimer, Slot
 from abc import ABC
+import time
 import cv2
 
 
@@ -44,7 +45,7 @@ class GStreamerProvider(Provider):
 
 
 class FrameReceiver(QObject):
-    frame_received = Signal(object)
+    frame_received = Signal(object, float)   # frame, time.perf_counter() when read
 
     def __init__(self):
         super().__init__()
@@ -92,7 +93,7 @@ class FrameReceiver(QObject):
     def read_frame(self):
         ret, frame = self.provider.get_frame()
         if ret:
-            self.frame_received.emit(frame)
+            self.frame_received.emit(frame, time.perf_counter())
 
     @Slot()
     def stop(self):
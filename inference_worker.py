@@ -1,11 +1,21 @@
 from PySide6.QtCore import QObject, Signal, Slot
-from PySide6.QtGui import QImage
 import numpy as np
 from abc import ABC
-import onnxruntime as ort
+from concurrent.futures import ThreadPoolExecutor
+import os
+import threading
 import warnings
+import math
+import time
 import yaml
 import cv2
+import native_tracker
+from session_manager import SessionManager
+
+
+def to_rgbx(frame: np.ndarray) -> np.ndarray:
+    """RGB24 -> RGBX8888, the layout the display uploads without converting"""
+    return cv2.cvtColor(frame, cv2.COLOR_RGB2RGBA) if frame.shape[2] == 3 else frame
 
 
 def to_uint8_image(frame: np.ndarray) -> np.ndarray:
@@ -14,17 +24,19 @@ def to_uint8_image(frame: np.ndarray) -> np.ndarray:
 
 
 class BaseInference(ABC):
-    def run(self, frame): raise NotImplementedError()
+    # timestamp: time.perf_counter() when the frame was received
+    def run(self, frame, timestamp=None): raise NotImplementedError()
 
 
 class IdentityInference(BaseInference):
-    def __init__(self, device):
-        self.device = device
-        self.session = ort.InferenceSession('models/identity.onnx', providers=self.device)
+    MODEL = ('models/identity.onnx', (480, 640, 3))
+
+    def __init__(self, sessions: SessionManager):
+        self.session = sessions.get(*self.MODEL)
         self.input_name = self.session.get_inputs()[0].name
         self.output_name = self.session.get_outputs()[0].name
     
-    def run(self, frame: np.ndarray):
+    def run(self, frame: np.ndarray, timestamp=None):
         # Ensure float32 and memory contiguity
         frame = np.ascontiguousarray(frame).astype(np.float32)
 
@@ -35,10 +47,12 @@ class IdentityInference(BaseInference):
 
 
 class Yolo11n(BaseInference):
-    def __init__(self, device, confidence=0.8, iou=0.7):
+    MODEL = ('models/yolo11n.onnx', (1, 3, 640, 640))
+
+    def __init__(self, sessions: SessionManager, confidence=0.8, iou=0.7):
         self.confidence = confidence
         self.iou = iou
-        self.session = ort.InferenceSession('models/yolo11n.onnx', providers=device)
+        self.session = sessions.get(*self.MODEL)
         with open("models/coco8.yaml", "r") as f:
             self.classes = yaml.safe_load(f)["names"]
     
@@ -74,15 +88,21 @@ class Yolo11n(BaseInference):
         area2 = (boxes[:, 2] - boxes[:, 0]) * (boxes[:, 3] - boxes[:, 1])
         return inter / (area1 + area2 - inter)
 
-    def run(self, frame):
+    def to_tensor(self, img):
+        """Letterboxed RGB uint8 -> 1x3xHxW float32 BGR in [0, 1]"""
+        return img[..., ::-1].transpose(2, 0, 1)[None].astype(np.float32) / 255.0
+
+    def detect(self, frame):
+        """Returns xyxy boxes in frame coordinates, scores and class ids"""
         h, w = frame.shape[:2]
         img, r, (dw, dh) = self.letterbox(frame)
-        img = img[..., ::-1].transpose(2, 0, 1)[None].astype(np.float32) / 255.0
+        img = self.to_tensor(img)
         
         pred = self.session.run(None, {self.session.get_inputs()[0].name: img})[0][0].T
         pred = pred[pred[:, 4] > self.confidence]
         
-        if len(pred) == 0: return frame
+        if len(pred) == 0:
+            return np.zeros((0, 4), np.float32), np.zeros(0, np.float32), np.zeros(0, np.int64)
         
         boxes = pred[:, :4]
         scores = pred[:, 4]
@@ -99,39 +119,151 @@ class Yolo11n(BaseInference):
         boxes[:, [0,2]] = (boxes[:, [0,2]] - dw) / r
         boxes[:, [1,3]] = (boxes[:, [1,3]] - dh) / r
         boxes = np.clip(boxes, 0, [w, h, w, h])
-        
-        # Draw
-        result = frame.copy()
-        for box, score, cls in zip(boxes.astype(int), scores, classes):
-            cv2.rectangle(result, box[:2], box[2:], (0,255,0), 2)
-            cv2.putText(result, f"{self.classes[cls]} {score:.2f}", 
-                       (box[0], box[1]-5), cv2.FONT_HERSHEY_SIMPLEX, 0.5, (0,255,0), 1)
+        return boxes, scores, classes
+
+    def draw(self, frame, boxes, scores, classes, ids=None):
+        if len(boxes) == 0: return frame
+
+        # Drawing needs a copy anyway, make it the RGBX one
+        result = to_rgbx(frame)
+        for i, (box, score, cls) in enumerate(zip(boxes.astype(int), scores, classes)):
+            label = f"{self.classes[int(cls)]} {score:.2f}"
+            if ids is not None:
+                label = f"#{int(ids[i])} {label}"
+            cv2.rectangle(result, box[:2], box[2:], (0,255,0,255), 2)
+            cv2.putText(result, label,
+                       (box[0], box[1]-5), cv2.FONT_HERSHEY_SIMPLEX, 0.5, (0,255,0,255), 1)
         
         return result
 
+    def run(self, frame, timestamp=None):
+        return self.draw(frame, *self.detect(frame))
+
+
+class TrackedYolo11n(BaseInference):
+    """YOLO11n every N frames, native SORT tracker on the frames in between
+
+    N follows the measured inference time so detection costs about one frame
+    budget on average. The frame budget is the interval between the receive
+    timestamps of consecutive frames (camera_fps is only the starting guess).
+    The detector also runs early when a track matched on the last detection
+    would decay below min_confidence on this frame; tracks already missed by
+    the detector are left to age out.
+    """
+
+    def __init__(self, sessions: SessionManager, camera_fps=30.0, max_interval=15, min_confidence=0.5):
+        self.detector = Yolo11n(sessions)
+        self.frame_budget = 1.0 / camera_fps
+        self.last_frame_time = None
+        self.tracks = np.zeros((0, 8), np.float32)
+        self.max_interval = max_interval
+        self.min_confidence = min_confidence
+        self.interval = 1
+        self.frames_since_detection = 0
+        self.inference_time = None
+
+        lib = native_tracker.load_sort_library()
+        if lib is None:
+            warnings.warn("native/build has no sort_tracker library, running the detector on every frame")
+            self.tracker = None
+        else:
+            self.tracker = native_tracker.SortTracker(lib)
+
+    def run(self, frame, timestamp=None):
+        if self.tracker is None:
+            return self.detector.run(frame)
+
+        self.measure_frame_interval(time.perf_counter() if timestamp is None else timestamp)
+        self.frames_since_detection += 1
+        # Decided before stepping the tracker: detect() steps it through update()
+        if self.frames_since_detection >= self.interval or self.confidence_low():
+            tracks = self.detect(frame)
+        else:
+            tracks = self.tracker.predict()
+        self.tracks = tracks
+
+        return self.detector.draw(frame, tracks[:, :4], tracks[:, 4], tracks[:, 5], ids=tracks[:, 6])
+
+    def confidence_low(self):
+        """True when a track matched on the last detection decays below min_confidence this frame"""
+        matched = self.tracks[self.tracks[:, 7] == 0]
+        return len(matched) > 0 and matched[:, 4].min() * self.tracker.confidence_decay < self.min_confidence
+
+    def detect(self, frame):
+        start = time.perf_counter()
+        boxes, scores, classes = self.detector.detect(frame)
+        elapsed = time.perf_counter() - start
+
+        # Smoothed inference time sets N, with 20% headroom for display and tracking
+        self.inference_time = elapsed if self.inference_time is None else 0.8 * self.inference_time + 0.2 * elapsed
+        self.interval = min(self.max_interval, max(1, math.ceil(self.inference_time / (0.8 * self.frame_budget))))
+        self.frames_since_detection = 0
+        return self.tracker.update(boxes, scores, classes)
+
+    def measure_frame_interval(self, timestamp):
+        # Receive times, not processing times: frames queued behind a detection
+        # are processed back to back but were received a camera frame apart
+        if self.last_frame_time is not None and timestamp > self.last_frame_time:
+            self.frame_budget = 0.9 * self.frame_budget + 0.1 * (timestamp - self.last_frame_time)
+        self.last_frame_time = timestamp
+
+
+RUNNERS = {
+    "Identity": IdentityInference,
+    "Object Detection": Yolo11n,
+    "Tracked Detection": TrackedYolo11n,
+}
+
 
 class InferenceWorker(QObject):
-    inference_done = Signal(QImage)
+    """Runs the selected model on every frame
 
-    def __init__(self, ort_device: str):
+    Switching models builds the new runner on a loader thread while the current
+    one keeps running; run_inference picks it up between two frames.
+    """
+    inference_done = Signal(object)
+
+    def __init__(self, ort_device: list, quantize_cpu=False):
         super().__init__()
-        self.device = ort_device
-        self.inference_runner = IdentityInference(device=self.device)
-    
+        self.sessions = SessionManager(ort_device, quantize_cpu=quantize_cpu)
+        self.inference_runner = IdentityInference(self.sessions)
+        self.lock = threading.Lock()
+        self.requested = "Identity"
+        self.pending_runner = None
+        self.loader = ThreadPoolExecutor(max_workers=1)
+        # Detection is the expensive load, have it resident before it is picked
+        if os.path.exists(Yolo11n.MODEL[0]):
+            self.loader.submit(self.sessions.get, *Yolo11n.MODEL)
+
     @Slot(str)
     def set_inference_runner(self, runner_string: str):
-        if runner_string == "Identity":
-            self.inference_runner = IdentityInference(device=self.device)
-        elif runner_string == "Object Detection":
-            self.inference_runner = Yolo11n(device=self.device)
-        else:
+        runner_class = RUNNERS.get(runner_string)
+        if runner_class is None:
             warnings.warn(f"No inference with name: {runner_string}")
+            return
+        with self.lock:
+            self.requested = runner_string
+        self.loader.submit(self.prepare_runner, runner_string, runner_class)
+
+    def prepare_runner(self, name, runner_class):
+        with self.lock:
+            if name != self.requested:
+                return  # superseded by a later selection
+        try:
+            runner = runner_class(self.sessions)
+        except Exception as e:
+            warnings.warn(f"Could not load {name}: {e}")
+            return
+        with self.lock:
+            if name == self.requested:
+                self.pending_runner = runner
 
-    @Slot(object)
-    def run_inference(self, rgb_frame: np.ndarray):
+    @Slot(object, float)
+    def run_inference(self, rgb_frame: np.ndarray, timestamp: float):
+        with self.lock:
+            if self.pending_runner is not None:
+                self.inference_runner, self.pending_runner = self.pending_runner, None
         # here we run the inference worker
-        rgb_frame = self.inference_runner.run(rgb_frame)
-        # expects a 3 channel RGB image (RGB24)
-        height, width, _ = rgb_frame.shape
-        qimage = QImage(rgb_frame.data, width, height, 3 * width, QImage.Format_RGB888).copy()
-        self.inference_done.emit(qimage)
+        frame = to_rgbx(self.inference_runner.run(rgb_frame, timestamp))
+        # RGBX8888 array, the display takes it by reference and uploads it as is
+        self.inference_done.emit(frame)
@@ -1,3 +1,4 @@
+import os
 import sys
 import time
 from PySide6.QtCore import Qt, QObject, Signal, Slot, Property, QSize, QThread, QTimer
@@ -7,6 +8,8 @@ from PySide6.QtGui import QImage
 from PySide6.QtQuick import QQuickImageProvider
 from frame_receiver import FrameReceiver
 from inference_worker import InferenceWorker
+from native_display import NativeDisplay
+import numpy as np
 import utils
 
 
@@ -22,8 +25,12 @@ class FrameProvider(QQuickImageProvider):
             return scaled
         return self.current_image
 
-    def update_image(self, qimage: QImage):
-        self.current_image = qimage.copy()
+    def update_image(self, frame: np.ndarray):
+        # The one copy of this path, QML may still be reading the previous image
+        frame = np.ascontiguousarray(frame)
+        height, width, channels = frame.shape
+        image_format = QImage.Format_RGBX8888 if channels == 4 else QImage.Format_RGB888
+        self.current_image = QImage(frame.data, width, height, frame.strides[0], image_format).copy()
 
 
 class Controller(QObject):
@@ -35,9 +42,10 @@ class Controller(QObject):
     change_frame_provider = Signal("QVariantMap")
     change_inference_runner = Signal(str)
 
-    def __init__(self, frame_provider):
+    def __init__(self, frame_provider, native_display=None):
         super().__init__()
         self.frame_provider = frame_provider
+        self.native_display = native_display
         self._image_size = QSize(640, 480)
         self._source_url = "image://frameprovider/current"
         self._device_name = ""
@@ -84,6 +92,10 @@ class Controller(QObject):
         fps = self.fps_tracker.compute_fps()
         self.fps = str(round(fps))
 
+    @Property(bool, constant=True)
+    def nativeDisplay(self):
+        return self.native_display is not None
+
     @Property(QSize, notify=imageSizeChanged)
     def imageSize(self):
         return self._image_size
@@ -104,11 +116,14 @@ class Controller(QObject):
             self._source_url = value
             self.sourceUrlChanged.emit()
 
-    @Slot(QImage)
-    def update_image(self, qimage: QImage):
+    @Slot(object)
+    def update_image(self, frame: np.ndarray):
         self.fps_tracker.add_frame()
-        self.frame_provider.update_image(qimage)
-        self.imageSize = qimage.size()
+        self.imageSize = QSize(frame.shape[1], frame.shape[0])
+        # Native item takes the frame by reference, falls through until QML has created it
+        if self.native_display and self.native_display.submit("inference", frame):
+            return
+        self.frame_provider.update_image(frame)
         self.sourceUrl = f"image://frameprovider/current?{time.time()}"
     
     @Slot("QVariantMap")
@@ -128,8 +143,12 @@ def main():
     frame_provider = FrameProvider()
     engine.addImageProvider("frameprovider", frame_provider)
 
+    # Native zero-copy display if native/ was built with Qt, image provider otherwise
+    native_display = NativeDisplay.load()
+    print(f"[main] Display: {'native FrameItem' if native_display else 'image provider'}")
+
     # Controller setup (only once!)
-    controller = Controller(frame_provider)
+    controller = Controller(frame_provider, native_display)
     engine.rootContext().setContextProperty("controller", controller)
 
     # Load QML
@@ -157,7 +176,8 @@ def main():
 
     # Setup InferenceWorker in its own thread
     inference_thread = QThread()
-    inference_worker = InferenceWorker(ort_device=ort_devices)
+    # VISION_INT8=1 runs dynamically quantized models on CPU
+    inference_worker = InferenceWorker(ort_device=ort_devices, quantize_cpu=os.environ.get("VISION_INT8") == "1")
     inference_worker.moveToThread(inference_thread)
 
     # Start inference thread
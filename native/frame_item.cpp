@@ -0,0 +1,255 @@
+#include "frame_item.h"
+#include <QHash>
+#include <QMutexLocker>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+#include <QSGSimpleTextureNode>
+#include <QSGTexture>
+#include <QThread>
+#include <rhi/qrhi.h>
+
+// ===================== Registry =====================
+
+static QMutex registryMutex;
+static QHash<QString, FrameItem *> registry;
+
+FrameItem *FrameItem::find(const QString &name)
+{
+    QMutexLocker lock(&registryMutex);
+    return registry.value(name, nullptr);
+}
+
+// ===================== FrameTexture =====================
+
+namespace {
+
+// Scene graph texture updated in place: the QRhiTexture (always RGBA8) is
+// only recreated when the frame size changes. The renderer calls
+// commitTextureOperations() before sampling, which records the upload.
+class FrameTexture : public QSGTexture {
+public:
+    ~FrameTexture() override
+    {
+        if (texture_)
+            texture_->deleteLater();
+    }
+
+    // RGBX8888 image, referenced until the upload is recorded
+    void setImage(const QImage &image)
+    {
+        image_ = image;
+        size_ = image.size();
+    }
+
+    qint64 comparisonKey() const override
+    {
+        return texture_ ? qint64(quintptr(texture_)) : qint64(quintptr(this));
+    }
+    QRhiTexture *rhiTexture() const override { return texture_; }
+    QSize textureSize() const override { return size_; }
+    bool hasAlphaChannel() const override { return false; }
+    bool hasMipmaps() const override { return false; }
+
+    void commitTextureOperations(QRhi *rhi, QRhiResourceUpdateBatch *updates) override
+    {
+        if (image_.isNull())
+            return;
+        if (!texture_ || texture_->pixelSize() != image_.size()) {
+            if (texture_)
+                texture_->deleteLater();
+            texture_ = rhi->newTexture(QRhiTexture::RGBA8, image_.size());
+            texture_->create();
+        }
+        updates->uploadTexture(texture_, image_);
+        image_ = QImage();
+    }
+
+private:
+    QRhiTexture *texture_ = nullptr;
+    QImage image_;
+    QSize size_;
+};
+
+}
+
+// ===================== FrameItem =====================
+
+FrameItem::FrameItem(QQuickItem *parent)
+    : QQuickItem(parent), pendingId_(-1), inFlightId_(-1), lastId_(-1), retiredId_(-1)
+{
+    setFlag(ItemHasContents, true);
+}
+
+FrameItem::~FrameItem()
+{
+    QObject::disconnect(swapConnection_);
+    QMutexLocker lock(&registryMutex);
+    if (registry.value(name_) == this)
+        registry.remove(name_);
+}
+
+QString FrameItem::name() const
+{
+    return name_;
+}
+
+void FrameItem::setName(const QString &name)
+{
+    if (name == name_)
+        return;
+    {
+        QMutexLocker lock(&registryMutex);
+        if (registry.value(name_) == this)
+            registry.remove(name_);
+        if (!name.isEmpty())
+            registry.insert(name, this);
+    }
+    name_ = name;
+    emit nameChanged();
+}
+
+QSize FrameItem::frameSize() const
+{
+    return frameSize_;
+}
+
+void FrameItem::setFrameSize(const QSize &size)
+{
+    if (size == frameSize_)
+        return;
+    frameSize_ = size;
+    emit frameSizeChanged();
+}
+
+void FrameItem::submit(const QImage &image, qint64 frameId)
+{
+    {
+        QMutexLocker lock(&mutex_);
+        // An undrawn predecessor is dropped here and retired right away
+        pending_ = image;
+        pendingId_ = frameId;
+        lastId_ = frameId;
+        updateRetired();
+    }
+
+    const QSize size = image.size();
+    if (QThread::currentThread() == thread()) {
+        setFrameSize(size);
+        update();
+    } else {
+        QMetaObject::invokeMethod(this, [this, size]() {
+            setFrameSize(size);
+            update();
+        }, Qt::QueuedConnection);
+    }
+}
+
+qint64 FrameItem::retiredId() const
+{
+    QMutexLocker lock(&mutex_);
+    return retiredId_;
+}
+
+void FrameItem::updateRetired()
+{
+    // Ids only grow, so everything older than the oldest referenced frame is free
+    const qint64 oldest = inFlightId_ >= 0 ? inFlightId_ : pendingId_;
+    retiredId_ = qMax(retiredId_, oldest >= 0 ? oldest - 1 : lastId_);
+}
+
+QSGNode *FrameItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    QSGSimpleTextureNode *node = static_cast<QSGSimpleTextureNode *>(oldNode);
+    const bool software = window()->rendererInterface()->graphicsApi() == QSGRendererInterface::Software;
+
+    QImage image;
+    {
+        QMutexLocker lock(&mutex_);
+        if (!pending_.isNull()) {
+            image = pending_;
+            inFlight_ = pending_;
+            inFlightId_ = pendingId_;
+            pending_ = QImage();
+            pendingId_ = -1;
+        }
+    }
+    if (!node && image.isNull())
+        return nullptr;
+
+    if (!node) {
+        node = new QSGSimpleTextureNode();
+        node->setOwnsTexture(true);
+        node->setFiltering(QSGTexture::Linear);
+        if (!software)
+            node->setTexture(new FrameTexture());
+    }
+
+    if (!image.isNull()) {
+        if (software) {
+            // The software renderer has no in-place upload, it gets a texture per frame
+            node->setTexture(window()->createTextureFromImage(image, QQuickWindow::TextureIsOpaque));
+        } else if (image.format() == QImage::Format_RGB888) {
+            // The texture needs 4 channels. The GUI's worker already hands over RGBX,
+            // this expansion only serves RGB callers; it copies, so the frame is free now.
+            // staging_ is no longer shared by then, the previous upload was submitted.
+            if (staging_.size() != image.size())
+                staging_ = QImage(image.size(), QImage::Format_RGBX8888);
+            for (int y = 0; y < image.height(); ++y) {
+                const uchar *src = image.constScanLine(y);
+                uchar *dst = staging_.scanLine(y);
+                for (int x = 0; x < image.width(); ++x) {
+                    dst[4 * x] = src[3 * x];
+                    dst[4 * x + 1] = src[3 * x + 1];
+                    dst[4 * x + 2] = src[3 * x + 2];
+                    dst[4 * x + 3] = 0xff;
+                }
+            }
+            static_cast<FrameTexture *>(node->texture())->setImage(staging_);
+            image = QImage();
+            releaseInFlight();
+        } else {
+            static_cast<FrameTexture *>(node->texture())->setImage(image);
+        }
+        node->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // Fit into the item keeping aspect ratio, like Image.PreserveAspectFit
+    const QSizeF source = node->texture()->textureSize();
+    const QRectF bounds = boundingRect();
+    const qreal scale = qMin(bounds.width() / source.width(), bounds.height() / source.height());
+    const QSizeF fitted = source * scale;
+    node->setRect(QRectF(bounds.x() + (bounds.width() - fitted.width()) / 2,
+                         bounds.y() + (bounds.height() - fitted.height()) / 2,
+                         fitted.width(), fitted.height()));
+    return node;
+}
+
+void FrameItem::releaseInFlight()
+{
+    QMutexLocker lock(&mutex_);
+    inFlight_ = QImage();
+    inFlightId_ = -1;
+    updateRetired();
+}
+
+void FrameItem::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    update();
+}
+
+void FrameItem::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    // frameSwapped is emitted on the render thread once the frame, and with it
+    // the recorded upload, has been submitted
+    if (change == ItemSceneChange) {
+        QObject::disconnect(swapConnection_);
+        // Not waiting for a frame the previous window may still be drawing
+        releaseInFlight();
+        if (value.window) {
+            swapConnection_ = connect(value.window, &QQuickWindow::frameSwapped, this,
+                                      &FrameItem::releaseInFlight, Qt::DirectConnection);
+        }
+    }
+    QQuickItem::itemChange(change, value);
+}
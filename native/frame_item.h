@@ -0,0 +1,72 @@
+// frame_item.h : QQuickItem showing frames handed over by reference
+//
+// Replaces the QQuickImageProvider round trip (QImage copies, a scaled copy
+// and a cache-busting URL per frame) with one upload per displayed frame into
+// a texture that lives as long as the frame size does. submit() only stores
+// a QImage wrapping the caller's memory. RGBX frames are uploaded from that
+// memory and retired once the frame is swapped; RGB frames are expanded into
+// a reused staging image (the texture needs 4 channels) and retired right
+// there. A frame replaced before it was drawn is retired immediately, so a
+// hidden or minimized window pins at most one frame.
+
+#pragma once
+
+#include <QImage>
+#include <QMetaObject>
+#include <QMutex>
+#include <QQuickItem>
+#include <QSize>
+#include <QString>
+
+class FrameItem : public QQuickItem {
+    Q_OBJECT
+    Q_PROPERTY(QString name READ name WRITE setName NOTIFY nameChanged)
+    Q_PROPERTY(QSize frameSize READ frameSize NOTIFY frameSizeChanged)
+
+public:
+    explicit FrameItem(QQuickItem *parent = nullptr);
+    ~FrameItem() override;
+
+    // Key for find(), so frames can be routed without a QObject pointer
+    QString name() const;
+    void setName(const QString &name);
+
+    QSize frameSize() const;
+
+    // Any thread, frame ids must increase. image must stay valid until
+    // retiredId() >= frameId.
+    void submit(const QImage &image, qint64 frameId);
+
+    // Every frame id up to this one is no longer referenced, -1 before the first.
+    qint64 retiredId() const;
+
+    static FrameItem *find(const QString &name);
+
+signals:
+    void nameChanged();
+    void frameSizeChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+
+private:
+    void releaseInFlight();
+    void updateRetired();   // mutex_ held
+    void setFrameSize(const QSize &size);
+
+    QString name_;
+    QSize frameSize_;
+    QMetaObject::Connection swapConnection_;
+
+    mutable QMutex mutex_;
+    QImage pending_;          // submitted, not yet picked up by the render thread
+    qint64 pendingId_;
+    QImage inFlight_;         // referenced by the texture until the frame is swapped
+    qint64 inFlightId_;
+    qint64 lastId_;
+    qint64 retiredId_;
+
+    QImage staging_;          // render thread only: RGB frames expanded to RGBX
+};
@@ -0,0 +1,29 @@
+#include "frame_item_api.h"
+#include "frame_item.h"
+#include <QCoreApplication>
+#include <QtQml/qqml.h>
+
+int frame_item_register(void)
+{
+    if (!QCoreApplication::instance())
+        return 0;
+    qmlRegisterType<FrameItem>("VisionNative", 1, 0, "FrameItem");
+    return 1;
+}
+
+int frame_item_submit(const char *name, const unsigned char *data, int width, int height,
+                      int stride, int channels, long long frame_id)
+{
+    FrameItem *item = FrameItem::find(QString::fromUtf8(name));
+    if (!item || (channels != 3 && channels != 4))
+        return 0;
+    QImage::Format format = channels == 3 ? QImage::Format_RGB888 : QImage::Format_RGBX8888;
+    item->submit(QImage(data, width, height, stride, format), frame_id);
+    return 1;
+}
+
+long long frame_item_retired(const char *name)
+{
+    FrameItem *item = FrameItem::find(QString::fromUtf8(name));
+    return item ? item->retiredId() : -1;
+}
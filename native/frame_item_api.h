@@ -0,0 +1,31 @@
+/* frame_item_api.h : C ABI of the FrameItem display for ctypes
+ *
+ * Call frame_item_register() once the Q(Gui)Application exists and before
+ * the QML that imports VisionNative is loaded. The library must be built
+ * against a Qt 6 no newer than the one PySide6 ships, it binds to the Qt
+ * libraries already loaded in the process.
+ */
+
+#pragma once
+
+#include "vision_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Registers FrameItem as "import VisionNative 1.0". Returns 1 on success. */
+VISION_API int frame_item_register(void);
+
+/* Shows an RGB888 (channels 3) or RGBX8888 (channels 4) frame in the FrameItem
+ * called name. data is referenced, not copied: keep it alive until
+ * frame_item_retired() reaches frame_id. Returns 0 if no such item exists. */
+VISION_API int frame_item_submit(const char *name, const unsigned char *data, int width, int height,
+                                 int stride, int channels, long long frame_id);
+
+/* Highest frame id the item no longer references, -1 if none or unknown item. */
+VISION_API long long frame_item_retired(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+#include "hungarian.h"
+#include <limits>
+
+// Potentials formulation with 1-based indices, needs rows <= cols.
+static std::vector<int> assign_rows(const std::vector<float> &cost, int rows, int cols, bool transposed)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> u(rows + 1, 0.0), v(cols + 1, 0.0);
+    std::vector<int> match(cols + 1, 0), way(cols + 1, 0);
+
+    for (int i = 1; i <= rows; ++i) {
+        match[0] = i;
+        int j0 = 0;
+        std::vector<double> min_to(cols + 1, inf);
+        std::vector<bool> used(cols + 1, false);
+        do {
+            used[j0] = true;
+            const int i0 = match[j0];
+            double delta = inf;
+            int j1 = 0;
+            for (int j = 1; j <= cols; ++j) {
+                if (used[j])
+                    continue;
+                const float c = transposed ? cost[(j - 1) * rows + (i0 - 1)] : cost[(i0 - 1) * cols + (j - 1)];
+                const double reduced = c - u[i0] - v[j];
+                if (reduced < min_to[j]) {
+                    min_to[j] = reduced;
+                    way[j] = j0;
+                }
+                if (min_to[j] < delta) {
+                    delta = min_to[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= cols; ++j) {
+                if (used[j]) {
+                    u[match[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    min_to[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (match[j0] != 0);
+        do {
+            const int j1 = way[j0];
+            match[j0] = match[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    std::vector<int> row_to_col(rows, -1);
+    for (int j = 1; j <= cols; ++j) {
+        if (match[j])
+            row_to_col[match[j] - 1] = j - 1;
+    }
+    return row_to_col;
+}
+
+std::vector<int> solve_assignment(const std::vector<float> &cost, int rows, int cols)
+{
+    if (rows == 0 || cols == 0)
+        return std::vector<int>(rows, -1);
+    if (rows <= cols)
+        return assign_rows(cost, rows, cols, false);
+
+    // More rows than columns: solve the transpose and invert the mapping
+    std::vector<int> col_to_row = assign_rows(cost, cols, rows, true);
+    std::vector<int> row_to_col(rows, -1);
+    for (int j = 0; j < cols; ++j) {
+        if (col_to_row[j] >= 0)
+            row_to_col[col_to_row[j]] = j;
+    }
+    return row_to_col;
+}
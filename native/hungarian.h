@@ -0,0 +1,12 @@
+// hungarian.h : minimum cost assignment (Hungarian / Kuhn-Munkres)
+//
+// O(n^2 m) shortest augmenting path variant, fine for the few dozen tracks
+// and detections a frame holds.
+
+#pragma once
+
+#include <vector>
+
+// cost is rows x cols, row-major, any sign. Returns the assigned column of
+// every row, -1 for rows left over when rows > cols.
+std::vector<int> solve_assignment(const std::vector<float> &cost, int rows, int cols);
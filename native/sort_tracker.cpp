@@ -0,0 +1,256 @@
+#include "sort_tracker.h"
+#include "hungarian.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ===================== Kalman filter =====================
+
+// Measurement noise on (u, v, s, r) and process noise, SORT's values.
+static const double MEASUREMENT_NOISE[4] = {1.0, 1.0, 10.0, 10.0};
+static const double PROCESS_NOISE[7] = {1.0, 1.0, 1.0, 1.0, 0.01, 0.01, 0.0001};
+
+static void to_measurement(const Detection &d, double z[4])
+{
+    const double w = d.x2 - d.x1, h = d.y2 - d.y1;
+    z[0] = d.x1 + w / 2.0;
+    z[1] = d.y1 + h / 2.0;
+    z[2] = w * h;
+    z[3] = h > 0.0 ? w / h : 1.0;
+}
+
+// In-place Gauss-Jordan inverse of a symmetric positive definite 4x4.
+static void invert4(double m[4][4])
+{
+    double inv[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+    for (int c = 0; c < 4; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < 4; ++r) {
+            if (std::fabs(m[r][c]) > std::fabs(m[pivot][c]))
+                pivot = r;
+        }
+        for (int k = 0; k < 4; ++k) {
+            std::swap(m[c][k], m[pivot][k]);
+            std::swap(inv[c][k], inv[pivot][k]);
+        }
+        const double scale = 1.0 / m[c][c];
+        for (int k = 0; k < 4; ++k) {
+            m[c][k] *= scale;
+            inv[c][k] *= scale;
+        }
+        for (int r = 0; r < 4; ++r) {
+            if (r == c)
+                continue;
+            const double f = m[r][c];
+            for (int k = 0; k < 4; ++k) {
+                m[r][k] -= f * m[c][k];
+                inv[r][k] -= f * inv[c][k];
+            }
+        }
+    }
+    memcpy(m, inv, sizeof(inv));
+}
+
+KalmanBoxFilter::KalmanBoxFilter(const Detection &detection)
+{
+    double z[4];
+    to_measurement(detection, z);
+    memset(x_, 0, sizeof(x_));
+    memset(P_, 0, sizeof(P_));
+    for (int i = 0; i < 4; ++i) {
+        x_[i] = z[i];
+        P_[i][i] = 10.0;
+    }
+    // Velocities are unknown until the second match
+    for (int i = 4; i < 7; ++i)
+        P_[i][i] = 10000.0;
+}
+
+void KalmanBoxFilter::predict()
+{
+    // Keep the area from going negative
+    if (x_[6] + x_[2] <= 0.0)
+        x_[6] = 0.0;
+
+    // x = F x with F = I plus position += velocity for u, v and s
+    for (int i = 0; i < 3; ++i)
+        x_[i] += x_[i + 4];
+
+    // P = F P F^T + Q, F only adds row/column i + 4 to i for i < 3
+    double fp[7][7];
+    for (int i = 0; i < 7; ++i) {
+        for (int j = 0; j < 7; ++j)
+            fp[i][j] = P_[i][j] + (i < 3 ? P_[i + 4][j] : 0.0);
+    }
+    for (int i = 0; i < 7; ++i) {
+        for (int j = 0; j < 7; ++j)
+            P_[i][j] = fp[i][j] + (j < 3 ? fp[i][j + 4] : 0.0);
+        P_[i][i] += PROCESS_NOISE[i];
+    }
+}
+
+void KalmanBoxFilter::update(const Detection &detection)
+{
+    double z[4];
+    to_measurement(detection, z);
+
+    // H picks the first four state entries, so S = P[0:4][0:4] + R
+    double s[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j)
+            s[i][j] = P_[i][j];
+        s[i][i] += MEASUREMENT_NOISE[i];
+    }
+    invert4(s);
+
+    // K = P H^T S^-1 = P[:, 0:4] S^-1
+    double k[7][4];
+    for (int i = 0; i < 7; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            double sum = 0.0;
+            for (int m = 0; m < 4; ++m)
+                sum += P_[i][m] * s[m][j];
+            k[i][j] = sum;
+        }
+    }
+
+    double y[4];
+    for (int i = 0; i < 4; ++i)
+        y[i] = z[i] - x_[i];
+    for (int i = 0; i < 7; ++i) {
+        for (int j = 0; j < 4; ++j)
+            x_[i] += k[i][j] * y[j];
+    }
+
+    // P = (I - K H) P = P - K P[0:4][:]
+    double p[7][7];
+    memcpy(p, P_, sizeof(p));
+    for (int i = 0; i < 7; ++i) {
+        for (int j = 0; j < 7; ++j) {
+            double sum = 0.0;
+            for (int m = 0; m < 4; ++m)
+                sum += k[i][m] * p[m][j];
+            P_[i][j] = p[i][j] - sum;
+        }
+    }
+}
+
+void KalmanBoxFilter::box(float *x1, float *y1, float *x2, float *y2) const
+{
+    const double area = std::max(x_[2], 0.0);
+    const double w = std::sqrt(area * std::max(x_[3], 0.0));
+    const double h = w > 0.0 ? area / w : 0.0;
+    *x1 = static_cast<float>(x_[0] - w / 2.0);
+    *y1 = static_cast<float>(x_[1] - h / 2.0);
+    *x2 = static_cast<float>(x_[0] + w / 2.0);
+    *y2 = static_cast<float>(x_[1] + h / 2.0);
+}
+
+// ===================== Tracker =====================
+
+static float iou(float ax1, float ay1, float ax2, float ay2, const Detection &b)
+{
+    const float w = std::min(ax2, b.x2) - std::max(ax1, b.x1);
+    const float h = std::min(ay2, b.y2) - std::max(ay1, b.y1);
+    if (w <= 0.0f || h <= 0.0f)
+        return 0.0f;
+    const float inter = w * h;
+    const float area_a = (ax2 - ax1) * (ay2 - ay1);
+    const float area_b = (b.x2 - b.x1) * (b.y2 - b.y1);
+    return inter / (area_a + area_b - inter);
+}
+
+SortTracker::SortTracker(int max_age, int min_hits, float iou_threshold, float confidence_decay)
+    : max_age_(max_age), min_hits_(min_hits), iou_threshold_(iou_threshold),
+      confidence_decay_(confidence_decay), next_id_(1)
+{
+}
+
+void SortTracker::step()
+{
+    for (size_t i = 0; i < tracks_.size(); ++i) {
+        tracks_[i].filter.predict();
+        tracks_[i].frames_since_match++;
+    }
+}
+
+std::vector<Track> SortTracker::update(const std::vector<Detection> &detections)
+{
+    step();
+
+    // Cost 1 - IoU, pairs below the threshold are rejected after assignment
+    const int rows = static_cast<int>(tracks_.size());
+    const int cols = static_cast<int>(detections.size());
+    std::vector<float> cost(static_cast<size_t>(rows) * cols);
+    std::vector<float> overlap(cost.size());
+    for (int t = 0; t < rows; ++t) {
+        float x1, y1, x2, y2;
+        tracks_[t].filter.box(&x1, &y1, &x2, &y2);
+        for (int d = 0; d < cols; ++d) {
+            overlap[t * cols + d] = iou(x1, y1, x2, y2, detections[d]);
+            cost[t * cols + d] = 1.0f - overlap[t * cols + d];
+        }
+    }
+    std::vector<int> assignment = solve_assignment(cost, rows, cols);
+
+    std::vector<bool> detection_used(cols, false);
+    for (int t = 0; t < rows; ++t) {
+        Tracklet &track = tracks_[t];
+        const int d = assignment[t];
+        if (d >= 0 && overlap[t * cols + d] >= iou_threshold_) {
+            track.filter.update(detections[d]);
+            track.class_id = detections[d].class_id;
+            track.score = detections[d].score;
+            track.hits++;
+            track.missed_updates = 0;
+            track.frames_since_match = 0;
+            detection_used[d] = true;
+        } else {
+            track.missed_updates++;
+        }
+    }
+
+    tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                                 [this](const Tracklet &t) { return t.missed_updates > max_age_; }),
+                  tracks_.end());
+
+    for (int d = 0; d < cols; ++d) {
+        if (detection_used[d])
+            continue;
+        Tracklet track = {KalmanBoxFilter(detections[d]), next_id_++, detections[d].class_id,
+                          detections[d].score, 1, 0, 0};
+        tracks_.push_back(track);
+    }
+    return confirmed();
+}
+
+std::vector<Track> SortTracker::predict()
+{
+    step();
+    return confirmed();
+}
+
+void SortTracker::reset()
+{
+    tracks_.clear();
+    next_id_ = 1;
+}
+
+std::vector<Track> SortTracker::confirmed() const
+{
+    std::vector<Track> out;
+    out.reserve(tracks_.size());
+    for (size_t i = 0; i < tracks_.size(); ++i) {
+        const Tracklet &t = tracks_[i];
+        if (t.hits < min_hits_)
+            continue;
+        Track track;
+        t.filter.box(&track.x1, &track.y1, &track.x2, &track.y2);
+        track.confidence = t.score * std::pow(confidence_decay_, static_cast<float>(t.frames_since_match));
+        track.class_id = t.class_id;
+        track.id = t.id;
+        track.missed_updates = t.missed_updates;
+        out.push_back(track);
+    }
+    return out;
+}
@@ -0,0 +1,77 @@
+// sort_tracker.h : SORT multi-object tracker
+//
+// Constant velocity Kalman filter per object on (centre x, centre y, area,
+// aspect ratio), IoU cost with Hungarian association, as in Bewley et al.,
+// "Simple Online and Realtime Tracking" (2016).
+//
+// Built for detect-then-track: predict() runs on every displayed frame and
+// costs a few microseconds, update() only on frames the detector ran on.
+
+#pragma once
+
+#include <vector>
+
+struct Detection {
+    float x1, y1, x2, y2;
+    float score;
+    int class_id;
+};
+
+struct Track {
+    float x1, y1, x2, y2;
+    float confidence;   // last detection score, decayed per frame without one
+    int class_id;
+    int id;
+    int missed_updates; // detector runs since the last match, 0 if the last one matched
+};
+
+// State (u, v, s, r, du, dv, ds); velocities are per predict() step.
+class KalmanBoxFilter {
+public:
+    explicit KalmanBoxFilter(const Detection &detection);
+
+    void predict();
+    void update(const Detection &detection);
+    void box(float *x1, float *y1, float *x2, float *y2) const;
+
+private:
+    double x_[7];
+    double P_[7][7];
+};
+
+class SortTracker {
+public:
+    // max_age: detector runs a track may go unmatched before it is dropped.
+    // min_hits: matched detections before a track is reported.
+    // confidence_decay: per-frame factor applied to confidence between matches.
+    SortTracker(int max_age, int min_hits, float iou_threshold, float confidence_decay);
+
+    // Advances every track one frame and matches it against detections.
+    std::vector<Track> update(const std::vector<Detection> &detections);
+
+    // Advances every track one frame without detections.
+    std::vector<Track> predict();
+
+    void reset();
+
+private:
+    struct Tracklet {
+        KalmanBoxFilter filter;
+        int id;
+        int class_id;
+        float score;
+        int hits;
+        int missed_updates;   // consecutive update() calls without a match
+        int frames_since_match;
+    };
+
+    void step();
+    std::vector<Track> confirmed() const;
+
+    int max_age_;
+    int min_hits_;
+    float iou_threshold_;
+    float confidence_decay_;
+    int next_id_;
+    std::vector<Tracklet> tracks_;
+};
@@ -0,0 +1,64 @@
+#include "tracker_api.h"
+#include "sort_tracker.h"
+
+struct SortHandle {
+    SortTracker tracker;
+    std::vector<Track> tracks;   // result of the last update or predict
+};
+
+int sort_tracks(const SortHandle *tracker, float *out, int capacity)
+{
+    const std::vector<Track> &tracks = tracker->tracks;
+    const int count = static_cast<int>(tracks.size());
+    for (int i = 0; i < count && i < capacity; ++i) {
+        float *row = out + i * 8;
+        row[0] = tracks[i].x1;
+        row[1] = tracks[i].y1;
+        row[2] = tracks[i].x2;
+        row[3] = tracks[i].y2;
+        row[4] = tracks[i].confidence;
+        row[5] = static_cast<float>(tracks[i].class_id);
+        row[6] = static_cast<float>(tracks[i].id);
+        row[7] = static_cast<float>(tracks[i].missed_updates);
+    }
+    return count;
+}
+
+SortHandle *sort_create(int max_age, int min_hits, float iou_threshold, float confidence_decay)
+{
+    return new SortHandle{SortTracker(max_age, min_hits, iou_threshold, confidence_decay), std::vector<Track>()};
+}
+
+void sort_destroy(SortHandle *tracker)
+{
+    delete tracker;
+}
+
+int sort_update(SortHandle *tracker, const float *detections, int count)
+{
+    std::vector<Detection> input(count);
+    for (int i = 0; i < count; ++i) {
+        const float *row = detections + i * 6;
+        Detection &d = input[i];
+        d.x1 = row[0];
+        d.y1 = row[1];
+        d.x2 = row[2];
+        d.y2 = row[3];
+        d.score = row[4];
+        d.class_id = static_cast<int>(row[5]);
+    }
+    tracker->tracks = tracker->tracker.update(input);
+    return static_cast<int>(tracker->tracks.size());
+}
+
+int sort_predict(SortHandle *tracker)
+{
+    tracker->tracks = tracker->tracker.predict();
+    return static_cast<int>(tracker->tracks.size());
+}
+
+void sort_reset(SortHandle *tracker)
+{
+    tracker->tracker.reset();
+    tracker->tracks.clear();
+}
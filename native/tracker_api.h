@@ -0,0 +1,32 @@
+/* tracker_api.h : C ABI of the SORT tracker for ctypes
+ *
+ * Detections are rows of 6 floats:  x1, y1, x2, y2, score, class
+ * Tracks are rows of 8 floats:      x1, y1, x2, y2, confidence, class, id, missed
+ *
+ * missed counts the detector runs since the track was last matched.
+ *
+ * sort_update() and sort_predict() advance one frame and return the number of
+ * confirmed tracks; sort_tracks() then copies up to capacity of them and can
+ * be called again with a larger buffer.
+ */
+
+#pragma once
+
+#include "vision_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SortHandle SortHandle;
+
+VISION_API SortHandle *sort_create(int max_age, int min_hits, float iou_threshold, float confidence_decay);
+VISION_API void sort_destroy(SortHandle *tracker);
+VISION_API int sort_update(SortHandle *tracker, const float *detections, int count);
+VISION_API int sort_predict(SortHandle *tracker);
+VISION_API int sort_tracks(const SortHandle *tracker, float *tracks, int capacity);
+VISION_API void sort_reset(SortHandle *tracker);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,9 @@
+/* vision_export.h : symbol export for the native libraries' C functions */
+
+#pragma once
+
+#if defined(_WIN32)
+#define VISION_API __declspec(dllexport)
+#else
+#define VISION_API __attribute__((visibility("default")))
+#endif
@@ -0,0 +1,65 @@
+import ctypes
+import os
+import numpy as np
+from native_tracker import library_path
+
+
+class NativeDisplay:
+    """Zero-copy frame display through the FrameItem QML type from native/
+
+    Frames are passed by pointer; each one is kept alive here until the item
+    reports it retired. At most MAX_IN_FLIGHT frames are held, newer ones are
+    dropped until the item catches up.
+    """
+    MAX_IN_FLIGHT = 3
+
+    def __init__(self, lib):
+        self.lib = lib
+        self.frame_id = 0
+        self.in_flight = {}
+
+    @staticmethod
+    def load():
+        """Registers "import VisionNative 1.0", returns None if native/ has no frame_item build"""
+        path = library_path("frame_item")
+        if not os.path.exists(path):
+            return None
+        try:
+            lib = ctypes.CDLL(path)
+        except OSError as e:
+            print(f"[NativeDisplay] Could not load {path}: {e}")
+            return None
+        lib.frame_item_register.argtypes = []
+        lib.frame_item_register.restype = ctypes.c_int
+        lib.frame_item_submit.argtypes = [ctypes.c_char_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int,
+                                          ctypes.c_int, ctypes.c_int, ctypes.c_longlong]
+        lib.frame_item_submit.restype = ctypes.c_int
+        lib.frame_item_retired.argtypes = [ctypes.c_char_p]
+        lib.frame_item_retired.restype = ctypes.c_longlong
+        if not lib.frame_item_register():
+            return None
+        return NativeDisplay(lib)
+
+    def submit(self, name: str, frame: np.ndarray) -> bool:
+        """Shows an RGBX (or RGB) uint8 frame in the FrameItem called name
+
+        RGBX is uploaded straight from frame; RGB costs a conversion on the render thread.
+
+        Returns False only when there is no such item; a frame dropped because
+        too many are in flight counts as handled.
+        """
+        key = name.encode()
+        retired = self.lib.frame_item_retired(key)
+        for frame_id in [i for i in self.in_flight if i <= retired]:
+            del self.in_flight[frame_id]
+        if len(self.in_flight) >= self.MAX_IN_FLIGHT:
+            return True
+
+        frame = np.ascontiguousarray(frame)
+        height, width, channels = frame.shape
+        self.frame_id += 1
+        if not self.lib.frame_item_submit(key, frame.ctypes.data, width, height, frame.strides[0],
+                                          channels, self.frame_id):
+            return False
+        self.in_flight[self.frame_id] = frame
+        return True
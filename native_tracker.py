@@ -0,0 +1,84 @@
+import ctypes
+import os
+import sys
+import numpy as np
+
+
+def library_path(name: str) -> str:
+    """Platform file name of a library built in native/build (or VISION_NATIVE_DIR)"""
+    if sys.platform == "win32":
+        filename = f"{name}.dll"
+    elif sys.platform == "darwin":
+        filename = f"lib{name}.dylib"
+    else:
+        filename = f"lib{name}.so"
+    default_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "native", "build")
+    return os.path.join(os.environ.get("VISION_NATIVE_DIR", default_dir), filename)
+
+
+def load_sort_library():
+    """Returns the SORT tracker library, or None if native/ has not been built"""
+    path = library_path("sort_tracker")
+    if not os.path.exists(path):
+        return None
+    lib = ctypes.CDLL(path)
+    float_p = ctypes.POINTER(ctypes.c_float)
+    lib.sort_create.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_float, ctypes.c_float]
+    lib.sort_create.restype = ctypes.c_void_p
+    lib.sort_destroy.argtypes = [ctypes.c_void_p]
+    lib.sort_destroy.restype = None
+    lib.sort_update.argtypes = [ctypes.c_void_p, float_p, ctypes.c_int]
+    lib.sort_update.restype = ctypes.c_int
+    lib.sort_predict.argtypes = [ctypes.c_void_p]
+    lib.sort_predict.restype = ctypes.c_int
+    lib.sort_tracks.argtypes = [ctypes.c_void_p, float_p, ctypes.c_int]
+    lib.sort_tracks.restype = ctypes.c_int
+    lib.sort_reset.argtypes = [ctypes.c_void_p]
+    lib.sort_reset.restype = None
+    return lib
+
+
+def _float_ptr(array: np.ndarray):
+    return array.ctypes.data_as(ctypes.POINTER(ctypes.c_float))
+
+
+class SortTracker:
+    """SORT tracker from native/ (Kalman filter + IoU/Hungarian association)
+
+    Tracks come back as an (n, 8) float32 array: x1, y1, x2, y2, confidence, class, id,
+    missed (detector runs since the track was last matched)
+    """
+
+    def __init__(self, lib, max_age: int = 3, min_hits: int = 1, iou_threshold: float = 0.3,
+                 confidence_decay: float = 0.95):
+        self.lib = lib
+        self.confidence_decay = confidence_decay
+        self.handle = lib.sort_create(max_age, min_hits, iou_threshold, confidence_decay)
+
+    def update(self, boxes: np.ndarray, scores: np.ndarray, classes: np.ndarray) -> np.ndarray:
+        """Advance one frame and match against detections (xyxy boxes)"""
+        detections = np.zeros((len(boxes), 6), dtype=np.float32)
+        if len(boxes):
+            detections[:, :4] = boxes
+            detections[:, 4] = scores
+            detections[:, 5] = classes
+        count = self.lib.sort_update(self.handle, _float_ptr(detections), len(detections))
+        return self._tracks(count)
+
+    def predict(self) -> np.ndarray:
+        """Advance one frame without detections"""
+        return self._tracks(self.lib.sort_predict(self.handle))
+
+    def reset(self):
+        self.lib.sort_reset(self.handle)
+
+    def _tracks(self, count: int) -> np.ndarray:
+        tracks = np.zeros((count, 8), dtype=np.float32)
+        if count:
+            self.lib.sort_tracks(self.handle, _float_ptr(tracks), count)
+        return tracks
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            self.lib.sort_destroy(self.handle)
+            self.handle = None
@@ -0,0 +1,120 @@
+import hashlib
+import os
+import threading
+import time
+import warnings
+from collections import OrderedDict
+import numpy as np
+import onnxruntime as ort
+
+
+_ORT_TO_NUMPY = {
+    "tensor(float)": np.float32,
+    "tensor(float16)": np.float16,
+    "tensor(double)": np.float64,
+    "tensor(uint8)": np.uint8,
+    "tensor(int8)": np.int8,
+    "tensor(int32)": np.int32,
+    "tensor(int64)": np.int64,
+}
+
+
+class SessionManager:
+    """Keeps recently used ONNX Runtime sessions resident
+
+    On the first load of a model on CPU the optimized graph is written to
+    cache_dir, later loads (also after a restart) skip graph optimization.
+    With quantize_cpu an INT8 dynamically quantized variant is built and used
+    instead. Every new session is warmed up with a dummy input so the first
+    real frame does not pay for lazy initialisation.
+    """
+
+    def __init__(self, providers, cache_dir="models/cache", capacity=3, quantize_cpu=False):
+        self.providers = providers
+        self.cache_dir = cache_dir
+        self.capacity = capacity
+        self.cpu = providers[0] == "CPUExecutionProvider"
+        self.quantize = quantize_cpu and self.cpu
+        self.sessions = OrderedDict()
+        self.lock = threading.Lock()
+        self.load_lock = threading.Lock()
+        os.makedirs(cache_dir, exist_ok=True)
+
+    def get(self, model_path: str, warmup_shape) -> ort.InferenceSession:
+        """Resident session for model_path, loaded and warmed up if needed. Thread safe."""
+        with self.lock:
+            if model_path in self.sessions:
+                self.sessions.move_to_end(model_path)
+                return self.sessions[model_path]
+
+        # One load at a time, a second request for the same model finds it resident
+        with self.load_lock:
+            with self.lock:
+                if model_path in self.sessions:
+                    self.sessions.move_to_end(model_path)
+                    return self.sessions[model_path]
+            session = self._load(model_path, warmup_shape)
+            with self.lock:
+                self.sessions[model_path] = session
+                while len(self.sessions) > self.capacity:
+                    evicted, _ = self.sessions.popitem(last=False)
+                    print(f"[SessionManager] Evicted {evicted}")
+            return session
+
+    def _load(self, model_path, warmup_shape):
+        start = time.perf_counter()
+        source = model_path
+        if self.quantize:
+            source = self._quantized(model_path)
+
+        options = ort.SessionOptions()
+        cached = None
+        if self.cpu:
+            # Compiled EPs (CoreML, TensorRT) cannot serialize their graphs, only cache for CPU
+            cached = self._cache_path(source, "opt")
+        if cached and os.path.exists(cached):
+            options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_DISABLE_ALL
+            session = ort.InferenceSession(cached, sess_options=options, providers=self.providers)
+            origin = "cached optimized graph"
+        else:
+            options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_ENABLE_ALL
+            if cached:
+                options.optimized_model_filepath = cached
+            session = ort.InferenceSession(source, sess_options=options, providers=self.providers)
+            origin = "optimized and cached" if cached else "optimized"
+        loaded = time.perf_counter()
+
+        self._warm_up(session, warmup_shape)
+        warmed = time.perf_counter()
+        print(f"[SessionManager] {os.path.basename(source)} ({origin}, {session.get_providers()[0]}): "
+              f"load {1000 * (loaded - start):.0f} ms, first inference {1000 * (warmed - loaded):.0f} ms")
+        return session
+
+    def _cache_path(self, model_path, tag):
+        # Keyed on the source file and ORT version so a new model or runtime rebuilds the cache
+        stat = os.stat(model_path)
+        key = f"{os.path.abspath(model_path)}:{stat.st_size}:{stat.st_mtime_ns}:{ort.__version__}"
+        digest = hashlib.sha1(key.encode()).hexdigest()[:10]
+        stem = os.path.splitext(os.path.basename(model_path))[0]
+        return os.path.join(self.cache_dir, f"{stem}.{tag}.{digest}.onnx")
+
+    def _quantized(self, model_path):
+        target = self._cache_path(model_path, "int8")
+        if os.path.exists(target):
+            return target
+        try:
+            from onnxruntime.quantization import QuantType, quantize_dynamic
+        except ImportError as e:
+            warnings.warn(f"INT8 quantization unavailable ({e}), using the float model")
+            return model_path
+        start = time.perf_counter()
+        quantize_dynamic(model_path, target, weight_type=QuantType.QUInt8)
+        print(f"[SessionManager] Quantized {os.path.basename(model_path)} to INT8 "
+              f"in {1000 * (time.perf_counter() - start):.0f} ms")
+        return target
+
+    @staticmethod
+    def _warm_up(session, warmup_shape):
+        model_input = session.get_inputs()[0]
+        dtype = _ORT_TO_NUMPY.get(model_input.type, np.float32)
+        session.run(None, {model_input.name: np.zeros(warmup_shape, dtype=dtype)})
@@ -0,0 +1,76 @@
+import numpy as np
+import pytest
+
+pytest.importorskip("cv2")
+pytest.importorskip("onnxruntime")
+pytest.importorskip("yaml")
+pytest.importorskip("PySide6")
+
+import inference_worker
+import native_tracker
+
+LIB = native_tracker.load_sort_library()
+pytestmark = pytest.mark.skipif(LIB is None, reason="native/build has no sort_tracker library")
+
+FRAME = np.zeros((480, 640, 3), np.uint8)
+
+
+class FakeDetector:
+    """Stands in for Yolo11n, returns queued detections"""
+
+    def __init__(self, sessions):
+        self.detections = []
+
+    def detect(self, frame):
+        return self.detections.pop(0)
+
+    def draw(self, frame, boxes, scores, classes, ids=None):
+        return frame
+
+
+def detection(x, score):
+    return np.array([[x, 100, x + 50, 200]], np.float32), np.array([score], np.float32), np.array([0])
+
+
+@pytest.fixture
+def runner(monkeypatch):
+    monkeypatch.setattr(inference_worker, "Yolo11n", FakeDetector)
+    return inference_worker.TrackedYolo11n(sessions=None)
+
+
+def test_early_detection_steps_tracker_once(runner):
+    # An object moving 10 px per frame. The 0.52 score decays below 0.5 one
+    # frame later, which triggers detection before the interval is up.
+    sequence = [detection(10 * i, score) for i, score in enumerate([0.9, 0.9, 0.52, 0.9])]
+    runner.detector.detections = list(sequence)
+    reference = native_tracker.SortTracker(LIB)
+
+    for i, (boxes, scores, classes) in enumerate(sequence):
+        if i == 2:
+            runner.inference_time = 1.0   # slow detector: next detection due far ahead
+        runner.run(FRAME, i / 30)
+        expected = reference.update(boxes, scores, classes)
+        np.testing.assert_allclose(runner.tracks, expected, rtol=1e-5)
+
+    assert runner.interval > 1
+    assert runner.frames_since_detection == 0   # frame 3 was an early detection
+    assert runner.tracks[0, 4] == pytest.approx(0.9)
+    assert runner.tracks[0, 7] == 0
+
+
+def test_unmatched_track_does_not_trigger_detection(runner):
+    runner.detector.detections = [detection(10, 0.52), detection(400, 0.9)]
+    runner.run(FRAME, 0.0)
+    runner.inference_time = 1.0
+    runner.run(FRAME, 1 / 30)    # misses the first object, it keeps decaying
+
+    runner.run(FRAME, 2 / 30)
+    assert runner.frames_since_detection == 1   # tracked, not detected
+
+
+def test_frame_budget_follows_receive_times(runner):
+    # Frames processed back to back after a detection still count a camera
+    # frame apart
+    for i in range(100):
+        runner.measure_frame_interval(i / 60)
+    assert runner.frame_budget == pytest.approx(1 / 60, rel=1e-3)
@@ -154,7 +154,8 @@ ApplicationWindow {
                             Repeater {
                                 model: [
                                     {icon: "▶️", name: "Identity", desc: "Simple Identity ONNX Model"},
-                                    {icon: "️🎯", name: "Object Detection", desc: "YOLO11n Object detection"}
+                                    {icon: "️🎯", name: "Object Detection", desc: "YOLO11n Object detection"},
+                                    {icon: "🛰️", name: "Tracked Detection", desc: "YOLO11n every N frames + SORT tracker"}
                                 ]
 
                                 Rectangle {
@@ -501,9 +502,19 @@ ApplicationWindow {
                         border.width: 1
                         clip: true
 
+                        // Native FrameItem when available (see native/README.md)
+                        Loader {
+                            id: nativeView
+                            anchors.fill: parent
+                            anchors.margins: 8
+                            active: controller.nativeDisplay
+                            source: "FrameView.qml"
+                        }
+
                         Image {
                             id: inferenceImage
-                            source: controller.sourceUrl
+                            visible: !nativeView.active
+                            source: nativeView.active ? "" : controller.sourceUrl
                             anchors.fill: parent
                             anchors.margins: 8
                             fillMode: Image.PreserveAspectFit